@@ -6,6 +6,7 @@
 #include <circle/util.h>
 #include <circle/setjmp.h>
 #include <circle/timer.h>
+#include <circle/synchronize.h>
 #include <circle/sched/scheduler.h>
 #include <circle/logger.h>
 
@@ -24,14 +25,37 @@ KB11 cpu;
 int kbdelay = 0;
 int clkdelay = 0;
 u64 systime,nowtime,clkdiv, ptime;
+u64 pacetime, paceticks ;
+u8 pacespeed = KB11_SPEED_MAX ;
 ODT odt ;
 
 extern volatile bool interrupted ;
 extern volatile bool halted ;
-extern volatile bool kb11hrottle ;
+volatile bool stopping = false ; // set once startup() has left the loop and is writing the disks back
+volatile bool stopped = false ; // set once startup() has left the loop and flushed the disks
+extern volatile u8 kb11speed ;
+
+// idle_init lets the generic timer signal an event each time bit 8 of the counter
+// rises, so WFE in WAIT wakes every 512 counter ticks even when nobody sends one
+static void idle_init() {
+#if AARCH == 32
+    u32 ctl ;
+    asm volatile ("mrc p15, 0, %0, c14, c1, 0" : "=r" (ctl)) ;
+    ctl = (ctl & ~0xfcu) | (8 << 4) | 4 ;
+    asm volatile ("mcr p15, 0, %0, c14, c1, 0" : : "r" (ctl)) ;
+#else
+    u64 ctl ;
+    asm volatile ("mrs %0, cntkctl_el1" : "=r" (ctl)) ;
+    ctl = (ctl & ~0xfcul) | (8 << 4) | 4 ;
+    asm volatile ("msr cntkctl_el1, %0" : : "r" (ctl)) ;
+#endif
+}
 
 void setup(const char *rkfile, const char *rlfile, const bool bBootmon) {
-	if (cpu.unibus.rk11.crtds[0].obj.lockid) {
+    idle_init() ;
+    cpu.unibus.cons.attach() ;
+
+	if (cpu.unibus.rk11.crtds[0].isopen()) {
 		return ;
     }
 
@@ -39,7 +63,7 @@ void setup(const char *rkfile, const char *rlfile, const bool bBootmon) {
         char name[26] = BASEPATH "RL11_00.RL02" ;
         name[NN] = '0' + drv ;
 
-	    FRESULT fr = f_open(&cpu.unibus.rl11.disks[drv], !drv ? rlfile : name, FA_READ | FA_WRITE);
+	    FRESULT fr = cpu.unibus.rl11.disks[drv].open(!drv ? rlfile : name, RL02_SIZE);
         if (FR_OK != fr && FR_EXIST != fr) {
             gprintf("f_open(%s) error: (%d)", !drv ? rlfile : name, fr) ;
             while (!interrupted) ;
@@ -50,7 +74,7 @@ void setup(const char *rkfile, const char *rlfile, const bool bBootmon) {
         char name[26] = BASEPATH "RK11_00.RK05" ;
         name[NN] = '0' + crtd ;
 
-        FRESULT fr = f_open(&cpu.unibus.rk11.crtds[crtd], !crtd ? rkfile : name, FA_READ | FA_WRITE);
+        FRESULT fr = cpu.unibus.rk11.crtds[crtd].open(!crtd ? rkfile : name, RK05_SIZE);
         if (FR_OK != fr && FR_EXIST != fr) {
             gprintf("f_open(%s) error: (%d)", !crtd ? rkfile : name, fr);
             while (!interrupted) ;
@@ -60,13 +84,49 @@ void setup(const char *rkfile, const char *rlfile, const bool bBootmon) {
     for (u8 u = 0; u < TC11_UNITS; u++) {
         char name[26] = BASEPATH "TC11_00.TAPE" ;
         name[NN] = '0' + u ;
-        FRESULT fr = f_open(&cpu.unibus.tc11.units[u].file, name, FA_READ | FA_WRITE | FA_OPEN_ALWAYS) ;
+        FRESULT fr = cpu.unibus.tc11.units[u].image.open(name, TC11_SIZE, true) ;
         if (FR_OK != fr && FR_EXIST != fr) {
             gprintf("f_open(%s) error: (%d)", name, fr) ;
             while (!interrupted) ;
         }
     }
 
+    // RH70 drives are there when an image is, RH70_0n.RP04, .RP06, .RM03 or .RM05 tells the type
+    for (u8 u = 0; u < RH70_DRIVES; u++) {
+        for (u8 t = 0; t < RP_NONE; t++) {
+            char name[26] = BASEPATH "RH70_00." ;
+            name[NN] = '0' + u ;
+            strcat(name, RH70::name((RPTYPE) t)) ;
+
+            FRESULT fr = cpu.unibus.rh70.drives[u].image.open(name, RH70::size((RPTYPE) t)) ;
+            if (FR_OK == fr || FR_EXIST == fr) {
+                cpu.unibus.rh70.drives[u].type = (RPTYPE) t ;
+                break ;
+            }
+            if (FR_NO_FILE != fr) {
+                gprintf("f_open(%s) error: (%d)", name, fr) ;
+            }
+        }
+    }
+
+    // MSCP units the same way, MSCP_0n.RD54, .RA81, .RA82 or .RA92
+    for (u8 u = 0; u < UDA50_UNITS; u++) {
+        for (u8 t = 0; t < RA_NONE; t++) {
+            char name[26] = BASEPATH "MSCP_00." ;
+            name[NN] = '0' + u ;
+            strcat(name, UDA50::name((RATYPE) t)) ;
+
+            FRESULT fr = cpu.unibus.uda50.units[u].image.open(name, UDA50::size((RATYPE) t)) ;
+            if (FR_OK == fr || FR_EXIST == fr) {
+                cpu.unibus.uda50.units[u].type = (RATYPE) t ;
+                break ;
+            }
+            if (FR_NO_FILE != fr) {
+                gprintf("f_open(%s) error: (%d)", name, fr) ;
+            }
+        }
+    }
+
     clkdiv = (u64)1000000 / (u64)60;
     systime = CTimer::GetClockTicks64() ;
     ptime = systime ;
@@ -102,72 +162,240 @@ void setup(const char *rkfile, const char *rlfile, const bool bBootmon) {
     }
     
     cpu.reset(bBootmon ? BOOTMON_BASE : BOOTRK_BASE);
+    cpu.events.schedule(EV_HOST, EV_HOST_PERIOD) ;
     cpu.cpuStatus = CPU_STATUS_ENABLE ;
 }
 
+/*
+ * Only aborts raised deep inside operand decode (MMU faults, bus errors,
+ * odd addresses) still unwind through trapbuf. Instruction traps are
+ * latched in cpu.trapreq and taken at the instruction boundary, and loop()
+ * keeps running after a trap or interrupt instead of returning to re-arm
+ * setjmp.
+ */
 jmp_buf trapbuf;
 
 void trap(u8 vec) { longjmp(trapbuf, vec); }
 
+inline void QTRAP(const u8 vec) {
+    cpu.trapat(vec) ;
+    if (cpu.cpuStatus == CPU_STATUS_STEP) {
+        cpu.cpuStatus = CPU_STATUS_HALT ;
+    }
+}
+
 inline bool QINTERRUPT() {
     u8 ivec = cpu.interrupt_vector() ;
     if (ivec) {
-        cpu.trapat(ivec) ;
-        if (cpu.cpuStatus == CPU_STATUS_STEP) {
-            cpu.cpuStatus = CPU_STATUS_HALT ;
+        if (ivec == INTPIR) {
+            cpu.events.schedule(EV_PIRQ, 1) ; // PIRQ is level triggered, raise it again if still requested
         }
+        QTRAP(ivec) ;
         return true ;
     }
 
     return false ;
 }
 
-inline void hw_step() {
-    if (cpu.cpuStatus != CPU_STATUS_HALT) {
-        cpu.unibus.rk11.step() ;
-        cpu.unibus.rl11.step() ;
-        cpu.unibus.tc11.step() ;
-        cpu.unibus.ptr_ptp.step() ;
-        cpu.unibus.lp11.step() ;
-        cpu.pirq() ;
-        
-        cpu.unibus.cons.xpoll() ;
-        cpu.unibus.dl11.xpoll() ;
+// pace holds the emulated time in step with the host clock while throttled,
+// more than 10 ms behind (WAIT, ODT, slow devices) is forgiven, not caught up on
+// speedup is how many times the instruction timing of an 11/70 a paced speed runs
+static inline u32 speedup(const u8 speed) {
+    switch (speed) {
+        case KB11_SPEED_2X:
+            return 2 ;
+        case KB11_SPEED_REAL:
+        default:
+            return 1 ;
+    }
+}
 
-        if (kbdelay++ > 60) {
-            cpu.unibus.cons.rpoll() ;
-            cpu.unibus.dl11.rpoll() ;
-            kbdelay = 0;
-        }
-        
-        nowtime = CTimer::GetClockTicks64() ;
-        if (nowtime - systime > clkdiv) {
-            cpu.unibus.kw11.tick();
-            systime = nowtime;
-        }
+inline void pace() {
+    const u8 speed = kb11speed ;
+    if (speed == KB11_SPEED_MAX) {
+        pacespeed = speed ;
+        return ;
+    }
 
-        if (nowtime - ptime > 10ul) { // 100 kHz
-            ptime = nowtime ;
-            cpu.unibus.kw11.ptick() ;
-        }
+    const u64 now = CTimer::GetClockTicks64() ;
+    const u64 due = pacetime + (cpu.ticks - paceticks) / (KB11_TICKS_PER_US * speedup(speed)) ;
+
+    if (speed != pacespeed || now > due + 10000) {
+        pacespeed = speed ;
+        pacetime = now ;
+        paceticks = cpu.ticks ;
+        return ;
+    }
 
-        cpu.unibus.toy.step() ;
+    while (CTimer::GetClockTicks64() < due) {
+        // ;
     }
 }
 
-void loop() {
-    auto vec = setjmp(trapbuf);
+// host_step polls the host clock and the terminal inputs, every EV_HOST_PERIOD iterations
+inline void host_step() {
+    pace() ;
 
-    if (vec) {
-        cpu.trapat(vec) ;
+    cpu.unibus.cons.rpoll() ;
+    if (++kbdelay > 3) {
+        cpu.unibus.dl11.rpoll() ;
+        kbdelay = 0;
+    }
 
-        if (cpu.cpuStatus == CPU_STATUS_STEP) {
-            cpu.cpuStatus = CPU_STATUS_HALT ;
+    // the DZ scan sleeps while the lines are quiet, telnet input wakes it
+    if (cpu.unibus.dz11.pending()) {
+        cpu.events.schedule(EV_DZ, 1) ;
+    }
+
+    nowtime = CTimer::GetClockTicks64() ;
+    if (nowtime - systime > clkdiv) {
+        cpu.unibus.kw11.tick();
+        systime = nowtime;
+    }
+
+    if (nowtime - ptime > 10ul) { // 100 kHz
+        ptime = nowtime ;
+        cpu.unibus.kw11.ptick() ;
+    }
+}
+
+// io_drain hands the transfers core 3 has finished back to their controllers
+inline void io_drain() {
+    IORequest r ;
+    while (cpu.io.done(r)) {
+        switch (r.owner) {
+            case EV_RK:
+                cpu.unibus.rk11.iodone(r.ok) ;
+                break ;
+            case EV_RL:
+                cpu.unibus.rl11.iodone(r.ok) ;
+                break ;
+            case EV_TC:
+                cpu.unibus.tc11.iodone(r.ok) ;
+                break ;
+            case EV_RH:
+                cpu.unibus.rh70.iodone(r.ok) ;
+                break ;
+            case EV_UDA:
+                cpu.unibus.uda50.iodone(r.tag, r.ok) ;
+                break ;
+            default:
+                break ;
         }
+    }
+}
 
+// hw_step runs the device events that are due, a busy device asks to be stepped again
+inline void hw_step() {
+    if (cpu.cpuStatus == CPU_STATUS_HALT || !cpu.events.tick()) {
         return ;
     }
 
+    if (cpu.io.completed()) {
+        io_drain() ;
+    }
+
+    EventID ev ;
+    while ((ev = cpu.events.expired()) != EV_COUNT) {
+        switch (ev) {
+            case EV_RK:
+                cpu.unibus.rk11.step() ;
+                if (cpu.unibus.rk11.busy()) {
+                    cpu.events.schedule(EV_RK, 1) ;
+                }
+                break ;
+            case EV_RL:
+                cpu.unibus.rl11.step() ;
+                if (cpu.unibus.rl11.busy()) {
+                    cpu.events.schedule(EV_RL, 1) ;
+                }
+                break ;
+            case EV_TC:
+                cpu.unibus.tc11.step() ;
+                if (cpu.unibus.tc11.busy()) {
+                    cpu.events.schedule(EV_TC, 1) ;
+                }
+                break ;
+            case EV_RH:
+                cpu.unibus.rh70.step() ;
+                if (cpu.unibus.rh70.busy()) {
+                    cpu.events.schedule(EV_RH, 1) ;
+                }
+                break ;
+            case EV_UDA:
+                cpu.unibus.uda50.step() ;
+                if (cpu.unibus.uda50.busy()) {
+                    cpu.events.schedule(EV_UDA, 1) ;
+                }
+                break ;
+            case EV_PTR:
+                cpu.unibus.ptr_ptp.ptr_step() ;
+                if (cpu.unibus.ptr_ptp.ptrbusy()) {
+                    cpu.events.schedule(EV_PTR, PTR_DELAY) ;
+                }
+                break ;
+            case EV_PTP:
+                cpu.unibus.ptr_ptp.ptp_step() ;
+                if (cpu.unibus.ptr_ptp.ptpbusy()) {
+                    cpu.events.schedule(EV_PTP, PTP_DELAY) ;
+                }
+                break ;
+            case EV_LP:
+                cpu.unibus.lp11.step() ;
+                if (cpu.unibus.lp11.busy()) {
+                    cpu.events.schedule(EV_LP, LP11_DELAY) ;
+                }
+                break ;
+            case EV_PIRQ:
+                cpu.pirq() ;
+                break ;
+            case EV_KL:
+                cpu.unibus.cons.xpoll() ;
+                if (cpu.unibus.cons.xbusy()) {
+                    cpu.events.schedule(EV_KL, EV_HOST_PERIOD) ;
+                }
+                break ;
+            case EV_KLR:
+                cpu.unibus.cons.rpoll() ;
+                if (cpu.unibus.cons.rbusy()) {
+                    cpu.events.schedule(EV_KLR, EV_HOST_PERIOD) ;
+                }
+                break ;
+            case EV_DL:
+                cpu.unibus.dl11.xpoll() ;
+                if (cpu.unibus.dl11.xbusy()) {
+                    cpu.events.schedule(EV_DL, EV_HOST_PERIOD) ;
+                }
+                break ;
+            case EV_DZ:
+                cpu.unibus.dz11.step() ;
+                if (cpu.unibus.dz11.busy()) {
+                    cpu.events.schedule(EV_DZ, DZ11_DELAY) ;
+                }
+                break ;
+            case EV_HOST:
+                host_step() ;
+                cpu.events.schedule(EV_HOST, EV_HOST_PERIOD) ;
+                break ;
+            case EV_TOY:
+                cpu.unibus.toy.step() ;
+                if (cpu.unibus.toy.busy()) {
+                    cpu.events.schedule(EV_TOY, 1) ;
+                }
+                break ;
+            default:
+                break ;
+        }
+    }
+}
+
+void loop() {
+    auto vec = setjmp(trapbuf);
+
+    if (vec) {
+        QTRAP(vec) ;
+    }
+
     while (!interrupted) {
         if (halted) {
             halted = false ;
@@ -175,21 +403,15 @@ void loop() {
         }
 
         if (cpu.cpuStatus == CPU_STATUS_HALT) {
+            cpu.flags() ;
             odt.loop() ;
             continue ;
         }
 
-        if (kb11hrottle) {
-            u64 now = CTimer::GetClockTicks64() ;
-            while (CTimer::GetClockTicks64() - now < 6) {
-                // ;
-            }
-        }
-
         hw_step() ;
         
         if (QINTERRUPT()) {
-            return ; // exit from loop to reset trapbuf
+            continue ;
         }
 
         if (!cpu.wtstate) {
@@ -199,9 +421,20 @@ void loop() {
 
             cpu.step();
 
+            if (cpu.trapreq) {
+                const u8 tvec = cpu.trapreq ;
+                cpu.trapreq = 0 ;
+                QTRAP(tvec) ;
+                continue ;
+            }
+
             if (cpu.odtbpt > 0 && cpu.RR[7] == cpu.odtbpt) {
                 cpu.cpuStatus = CPU_STATUS_HALT ;
             }
+        } else if (cpu.events.idle()) {
+            // nothing can end the WAIT before the host clock is due, nap on the core
+            WaitForEvent() ;
+            cpu.events.skip() ;
         }
 
         if (!cpu.wasSPL) {
@@ -214,20 +447,23 @@ void loop() {
         } else if (cpu.stackTrap == STACK_TRAP_RED) {
             cpu.errorRegister = 4 ;
             cpu.RR[6] = 4 ;
-            trap(INTBUS) ;
+            QTRAP(INTBUS) ;
+            continue ;
         }
 
         if (QINTERRUPT()) {
-            return ; // exit from loop to reset trapbuf
+            continue ;
         }
 
         if ((cpu.PSW & PSW_BIT_T) && !cpu.wasRTT) {
-            trap(INTDEBUG) ;
+            QTRAP(INTDEBUG) ;
+            continue ;
         }
 
         if (cpu.mmu.infotrap) {
             cpu.mmu.infotrap = false ;
-            trap(INTFAULT) ;
+            QTRAP(INTFAULT) ;
+            continue ;
         }
 
         if (cpu.cpuStatus == CPU_STATUS_STEP) {
@@ -245,5 +481,36 @@ TShutdownMode startup(const char *rkfile, const char *rlfile, const bool bootmon
         loop();
     }
 
+    stopping = true ;
+    while (!cpu.io.idle()) ; // core 3 finishes what was posted
+    io_drain() ;
+    DiskImage::flushall() ;
+    stopped = true ;
+
     return Console::get()->shutdownMode ;
 }
+
+// iocore serves the disk transfers and writes the cached disk images back, it runs on core 3
+void iocore() {
+    idle_init() ;
+
+    u64 last = CTimer::GetClockTicks64() ;
+
+    while (true) {
+        if (cpu.io.serve()) {
+            continue ;
+        }
+
+        if (stopped) { // startup() has drained the ring and flushed
+            break ;
+        }
+
+        const u64 now = CTimer::GetClockTicks64() ;
+        if (now - last >= DISK_POLL * 1000ul) {
+            DiskImage::pollall(now) ;
+            last = now ;
+        } else {
+            WaitForEvent() ; // woken by post() or the timer event stream
+        }
+    }
+}
@@ -24,12 +24,23 @@ enum INTVEC : u8 {
     INTFIS    = 0244,
     INTFPP    = 0244,
     INTFAULT  = 0250,
+    INTRH     = 0254,
     INTDLR    = 0300,
-    INTDLT    = 0304
+    INTDLT    = 0304,
+    INTDZR    = 0310,
+    INTDZT    = 0314
 };
 
 void trap(u8 num);
 
+// kb11speed, how fast loop() lets the emulated 11/70 run
+enum KB11Speed : u8 {
+    KB11_SPEED_MAX,  // as fast as the host goes
+    KB11_SPEED_REAL, // 11/70 instruction timing
+    KB11_SPEED_2X,   // twice that
+    KB11_SPEED_COUNT
+};
+
 typedef int t_bool;
 
 /* Floating point accumulators */
@@ -0,0 +1,601 @@
+#include "disk.h"
+
+#include <circle/logger.h>
+#include <circle/memory.h>
+#include <circle/timer.h>
+#include <circle/util.h>
+#include <fatfs/diskio.h>
+
+DiskImage *DiskImage::images = 0 ;
+u32 DiskImage::interval = DISK_FLUSH_INTERVAL ;
+bool DiskImage::contig = false ;
+
+// the first sector of a delta file, the bitmap follows in the next
+#define COW_MAGIC "PIP11COW"
+struct CowHeader {
+    char magic[8] ;
+    u32 sectors ;
+} ;
+
+// fits tells whether n sectors and b bitmaps for them can be had from the heap, new panics when it runs out
+static bool fits(const u32 n, const u32 b) {
+    const u64 need = (u64) n * DISK_SECTOR + (u64) b * ((n + 31) / 32) * sizeof(u32) + DISK_RESERVE ;
+    return CMemorySystem::Get()->GetHeapFreeSpace(HEAP_DEFAULT_NEW) >= need ;
+}
+
+// sidename makes the name of a file kept beside an image, name and ext
+static bool sidename(char *to, const char *name, const char *ext) {
+    if (strlen(name) + strlen(ext) > FF_MAX_LFN) {
+        return false ;
+    }
+    strcpy(to, name) ;
+    strcat(to, ext) ;
+    return true ;
+}
+
+// lbaio moves a run by LBA in pieces of DISK_CHUNK, the card driver takes no more than 0xffff blocks a command
+static DRESULT lbaio(FATFS *fs, u8 *buf, LBA_t lba, u32 n, const bool w) {
+    DRESULT r = RES_OK ;
+    ff_mutex_take(fs->ldrv) ;
+    while (n && RES_OK == r) {
+        const u32 k = n < DISK_CHUNK ? n : DISK_CHUNK ;
+        r = w ? disk_write(fs->pdrv, buf, lba, k) : disk_read(fs->pdrv, buf, lba, k) ;
+        buf += k * DISK_SECTOR ;
+        lba += k ;
+        n -= k ;
+    }
+    ff_mutex_give(fs->ldrv) ;
+    return r ;
+}
+
+DiskImage::DiskImage()
+:   size(0),
+    opened(false),
+    data(0),
+    dirty(0),
+    sectors(0),
+    lock(TASK_LEVEL),
+    sync(SYNC_INTERVAL),
+    every(0),
+    pending(false),
+    flushed(0),
+    written(0),
+    lba(0),
+    clmt(0),
+    delta(0),
+    revert(false),
+    cow(0),
+    cowoff(0),
+    next(0)
+{
+}
+
+FRESULT DiskImage::open(const char *name, const u32 capacity, const bool create) {
+    if (delta) {
+        return opencow(name, capacity) ;
+    }
+
+    // a relay cut short by a power loss leaves the image under its backup name
+    char bak[FF_MAX_LFN + 1] ;
+    if (sidename(bak, name, ".BAK") && FR_NO_FILE == f_stat(name, 0) && FR_OK == f_stat(bak, 0)) {
+        CLogger::Get()->Write("DISK", LogNotice, "%s: taken back from %s", name, bak) ;
+        f_rename(bak, name) ;
+    }
+
+    FRESULT fr = f_open(&file, name, FA_READ | FA_WRITE | (create ? FA_OPEN_ALWAYS : 0)) ;
+    if (FR_OK != fr && FR_EXIST != fr) {
+        return fr ;
+    }
+
+    opened = true ;
+    size = f_size(&file) > capacity ? f_size(&file) : capacity ;
+    sectors = (size + DISK_SECTOR - 1) / DISK_SECTOR ;
+
+    if (sectors > DISK_CACHE_MAX / DISK_SECTOR) {
+        CLogger::Get()->Write("DISK", LogNotice, "%s: too large to cache, served from the card", name) ;
+        direct() ;
+    } else if (!fits(sectors, 1)) {
+        CLogger::Get()->Write("DISK", LogError, "%s: no memory for the image, not cached", name) ;
+        direct() ;
+    } else {
+        data = new u8[sectors * DISK_SECTOR] ;
+        dirty = new u32[(sectors + 31) / 32] ;
+        memset(data, 0, sectors * DISK_SECTOR) ;
+        memset(dirty, 0, (sectors + 31) / 32 * sizeof(u32)) ;
+
+        const bool fresh = !f_size(&file) ;
+        if (fresh) {
+            // a new image, allocate it in one piece and let the first flush write the zeros
+            if (FR_OK == f_expand(&file, sectors * DISK_SECTOR, 1)) {
+                f_sync(&file) ;
+                memset(dirty, 0xff, (sectors + 31) / 32 * sizeof(u32)) ;
+                pending = true ;
+            }
+        }
+
+        // the clusters of a new image hold what was on the card before, the zeros are its contents
+        lba = locate() ;
+        if (fresh) {
+            CLogger::Get()->Write("DISK", LogNotice, "%s: new image of %u sectors", name, sectors) ;
+        } else if (lba) {
+            if (RES_OK != lbaio(file.obj.fs, data, lba, sectors, false)) {
+                CLogger::Get()->Write("DISK", LogError, "%s: read error", name) ;
+            }
+        } else {
+            UINT br ;
+            fr = f_read(&file, data, f_size(&file), &br) ;
+            if (FR_OK != fr) {
+                CLogger::Get()->Write("DISK", LogError, "%s: read error %d", name, fr) ;
+            }
+
+            if (contig && f_size(&file) && !relay(name)) {
+                CLogger::Get()->Write("DISK", LogError, "%s: could not be made contiguous", name) ;
+            }
+        }
+    }
+
+    next = images ;
+    __atomic_store_n(&images, this, __ATOMIC_RELEASE) ; // core 3 walks the list
+
+    return FR_OK ;
+}
+
+void DiskImage::close() {
+    if (!opened) {
+        return ;
+    }
+
+    flush() ;
+    f_close(&file) ;
+    opened = false ;
+}
+
+bool DiskImage::read(const u32 pos, void *buf, const u32 len) {
+    if (pos + len > size) {
+        return false ;
+    }
+
+    if (data) {
+        memcpy(buf, data + pos, len) ;
+        return true ;
+    }
+
+    if (lba) {
+        return lbarw(pos, (u8 *) buf, len, false) ;
+    }
+
+    UINT br ;
+    return FR_OK == f_lseek(&file, pos) && FR_OK == f_read(&file, buf, len, &br) ;
+}
+
+bool DiskImage::write(const u32 pos, const void *buf, const u32 len) {
+    if (pos + len > size) {
+        return false ;
+    }
+
+    if (data) {
+        memcpy(data + pos, buf, len) ;
+        // mark after the copy, a flush that clears the bit meanwhile sees it again
+        for (u32 s = pos / DISK_SECTOR; s <= (pos + len - 1) / DISK_SECTOR; s++) {
+            __atomic_fetch_or(&dirty[s >> 5], 1u << (s & 31), __ATOMIC_RELEASE) ;
+        }
+    } else if (lba) {
+        if (!lbarw(pos, (u8 *) buf, len, true)) {
+            return false ;
+        }
+    } else {
+        UINT bw ;
+        if (FR_OK != f_lseek(&file, pos) || FR_OK != f_write(&file, buf, len, &bw)) {
+            return false ;
+        }
+    }
+
+    pending = true ;
+    if (sync == SYNC_ALWAYS) {
+        flush() ;
+    } else if (sync == SYNC_IDLE) {
+        written = CTimer::GetClockTicks64() ;
+    }
+    return true ;
+}
+
+/*
+ * Runs of dirty sectors go out with one f_write each. The bits are cleared
+ * before the data is copied out, so a sector the emulator writes again in
+ * between stays dirty for the next round. The f_sync at the end puts the
+ * FAT and directory entry on the card, once for the whole round.
+ */
+void DiskImage::flush() {
+    if (!opened || !pending) {
+        return ;
+    }
+
+    lock.Acquire() ;
+
+    pending = false ;
+    flushed = CTimer::GetClockTicks64() ;
+
+    u32 s = 0 ;
+    u32 lo = sectors, hi = 0 ; // bitmap words of an overlay that changed
+    while (data && s < sectors) {
+        if (!dirty[s >> 5]) {
+            s = (s | 31) + 1 ;
+            continue ;
+        }
+
+        if (!(__atomic_fetch_and(&dirty[s >> 5], ~(1u << (s & 31)), __ATOMIC_ACQUIRE) & (1u << (s & 31)))) {
+            s++ ;
+            continue ;
+        }
+
+        u32 e = s + 1 ;
+        while (e < sectors && (__atomic_fetch_and(&dirty[e >> 5], ~(1u << (e & 31)), __ATOMIC_ACQUIRE) & (1u << (e & 31)))) {
+            e++ ;
+        }
+
+        FRESULT fr ;
+        if (cow) {
+            UINT bw ;
+            fr = f_lseek(&file, cowoff + s * DISK_SECTOR) ;
+            if (FR_OK == fr) {
+                fr = f_write(&file, data + s * DISK_SECTOR, (e - s) * DISK_SECTOR, &bw) ;
+            }
+            if (FR_OK == fr) {
+                for (u32 i = s; i < e; i++) {
+                    cow[i >> 5] |= 1u << (i & 31) ;
+                }
+                lo = lo < (s >> 5) ? lo : s >> 5 ;
+                hi = hi > ((e - 1) >> 5) + 1 ? hi : ((e - 1) >> 5) + 1 ;
+            }
+        } else if (lba) {
+            fr = RES_OK == lbaio(file.obj.fs, data + s * DISK_SECTOR, lba + s, e - s, true) ? FR_OK : FR_DISK_ERR ;
+        } else {
+            UINT bw ;
+            fr = f_lseek(&file, s * DISK_SECTOR) ;
+            if (FR_OK == fr) {
+                fr = f_write(&file, data + s * DISK_SECTOR, (e - s) * DISK_SECTOR, &bw) ;
+            }
+        }
+        if (FR_OK != fr) {
+            CLogger::Get()->Write("DISK", LogError, "write back of sectors %u-%u failed: %d", s, e - 1, fr) ;
+            for (u32 i = s; i < e; i++) {
+                __atomic_fetch_or(&dirty[i >> 5], 1u << (i & 31), __ATOMIC_RELAXED) ;
+            }
+            pending = true ;
+        }
+
+        s = e ;
+    }
+
+    if (hi > lo) {
+        // the sectors are in the delta before the bitmap says so
+        UINT bw ;
+        if (FR_OK != f_lseek(&file, DISK_SECTOR + lo * sizeof(u32)) || FR_OK != f_write(&file, cow + lo, (hi - lo) * sizeof(u32), &bw)) {
+            CLogger::Get()->Write("DISK", LogError, "%s: bitmap write failed", delta) ;
+        }
+    }
+
+    if (!lba) {
+        f_sync(&file) ; // sectors written by LBA leave the FAT and the directory as they are
+    }
+
+    lock.Release() ;
+}
+
+/*
+ * With a cluster link map of a single fragment, [0] is the table size, [1]
+ * the run length, [2] the first cluster and [3] the terminator. f_lseek()
+ * fails with FR_NOT_ENOUGH_CORE when the file has more fragments than that.
+ */
+LBA_t DiskImage::locate() {
+    if (f_size(&file) < sectors * DISK_SECTOR) {
+        return 0 ;
+    }
+
+    DWORD clmt[4] ;
+    clmt[0] = 4 ;
+    file.cltbl = clmt ;
+    FRESULT fr = f_lseek(&file, CREATE_LINKMAP) ;
+    file.cltbl = 0 ;
+    if (FR_OK != fr) {
+        return 0 ;
+    }
+
+    FATFS *fs = file.obj.fs ;
+    return fs->database + (LBA_t) (clmt[2] - 2) * fs->csize ;
+}
+
+/*
+ * direct sets up an image that is not cached. A contiguous one is served by
+ * LBA, a fragmented one keeps a cluster link map so that f_lseek() does not
+ * walk the FAT chain on every transfer. The map fixes the file size, an
+ * image shorter than its drive has to grow and goes without.
+ */
+void DiskImage::direct() {
+    lba = locate() ;
+    if (lba || f_size(&file) < sectors * DISK_SECTOR) {
+        return ;
+    }
+
+    DWORD probe[2] ;
+    probe[0] = 2 ;
+    file.cltbl = probe ;
+    FRESULT fr = f_lseek(&file, CREATE_LINKMAP) ; // fails and leaves the size the map needs in [0]
+    file.cltbl = 0 ;
+    if (FR_NOT_ENOUGH_CORE != fr || CMemorySystem::Get()->GetHeapFreeSpace(HEAP_DEFAULT_NEW) < probe[0] * sizeof(DWORD) + DISK_RESERVE) {
+        return ;
+    }
+
+    clmt = new DWORD[probe[0]] ;
+    clmt[0] = probe[0] ;
+    file.cltbl = clmt ;
+    if (FR_OK != f_lseek(&file, CREATE_LINKMAP)) {
+        file.cltbl = 0 ;
+        delete [] clmt ;
+        clmt = 0 ;
+    }
+}
+
+// lbarw moves a transfer of a contiguous image left on the card, partial sectors go through bounce
+bool DiskImage::lbarw(u32 pos, u8 *buf, u32 len, const bool w) {
+    FATFS *fs = file.obj.fs ;
+    while (len) {
+        const u32 s = pos / DISK_SECTOR ;
+        const u32 off = pos % DISK_SECTOR ;
+
+        if (!off && len >= DISK_SECTOR && !((uintptr) buf & 3)) {
+            const u32 n = len / DISK_SECTOR ;
+            if (RES_OK != lbaio(fs, buf, lba + s, n, w)) {
+                return false ;
+            }
+            pos += n * DISK_SECTOR ;
+            buf += n * DISK_SECTOR ;
+            len -= n * DISK_SECTOR ;
+            continue ;
+        }
+
+        const u32 k = DISK_SECTOR - off < len ? DISK_SECTOR - off : len ;
+        if ((!w || k < DISK_SECTOR) && RES_OK != lbaio(fs, bounce, lba + s, 1, false)) {
+            return false ;
+        }
+        if (w) {
+            memcpy(bounce + off, buf, k) ;
+            if (RES_OK != lbaio(fs, bounce, lba + s, 1, true)) {
+                return false ;
+            }
+        } else {
+            memcpy(buf, bounce + off, k) ;
+        }
+        pos += k ;
+        buf += k ;
+        len -= k ;
+    }
+
+    return true ;
+}
+
+/*
+ * relay writes the RAM copy to a new contiguous file and puts it in place of
+ * the fragmented one. The old file is renamed aside until the new one has its
+ * name, so a power loss in between leaves one of them under a name to find.
+ */
+bool DiskImage::relay(const char *name) {
+    char tmp[FF_MAX_LFN + 1] ;
+    char bak[FF_MAX_LFN + 1] ;
+    if (!sidename(tmp, name, ".TMP") || !sidename(bak, name, ".BAK")) {
+        return false ;
+    }
+
+    FIL nf ;
+    if (FR_OK != f_open(&nf, tmp, FA_READ | FA_WRITE | FA_CREATE_ALWAYS)) {
+        return false ;
+    }
+
+    UINT bw ;
+    if (FR_OK != f_expand(&nf, sectors * DISK_SECTOR, 1) || FR_OK != f_write(&nf, data, sectors * DISK_SECTOR, &bw)) {
+        f_close(&nf) ;
+        f_unlink(tmp) ;
+        return false ;
+    }
+    f_close(&nf) ;
+
+    f_close(&file) ;
+    f_unlink(bak) ;
+    bool swapped = false ;
+    if (FR_OK != f_rename(name, bak)) {
+        f_unlink(tmp) ;
+    } else if (FR_OK != f_rename(tmp, name)) {
+        f_rename(bak, name) ;
+        f_unlink(tmp) ;
+    } else {
+        swapped = true ;
+        if (FR_OK != f_unlink(bak)) {
+            CLogger::Get()->Write("DISK", LogError, "%s: could not be removed", bak) ;
+        }
+    }
+
+    if (FR_OK != f_open(&file, name, FA_READ | FA_WRITE)) {
+        CLogger::Get()->Write("DISK", LogError, "%s: cannot be opened again", name) ;
+        opened = false ;
+        lba = 0 ;
+        return false ;
+    }
+
+    if (!swapped) {
+        return false ;
+    }
+
+    lba = locate() ;
+    CLogger::Get()->Write("DISK", LogNotice, "%s: made contiguous", name) ;
+    return lba != 0 ;
+}
+
+void DiskImage::overlay(const char *delta, const bool reset) {
+    this->delta = delta ;
+    revert = reset ;
+}
+
+/*
+ * opencow loads the base into RAM and lays the sectors of the delta over it.
+ * An overlay has to be cached: with no memory for it, or for an image over
+ * DISK_CACHE_MAX, there is nowhere to keep the base apart from the writes
+ * and the open fails before anything is taken from the heap. A delta that
+ * is new, was made for an image of another size or is asked to be reset
+ * starts empty.
+ */
+FRESULT DiskImage::opencow(const char *name, const u32 capacity) {
+    FIL base ;
+    FRESULT fr = f_open(&base, name, FA_READ) ;
+    if (FR_OK != fr) {
+        return fr ;
+    }
+
+    size = f_size(&base) > capacity ? f_size(&base) : capacity ;
+    sectors = (size + DISK_SECTOR - 1) / DISK_SECTOR ;
+    u32 words = (sectors + 31) / 32 ;
+    cowoff = DISK_SECTOR + (words * sizeof(u32) + DISK_SECTOR - 1) / DISK_SECTOR * DISK_SECTOR ;
+
+    if (sectors > DISK_CACHE_MAX / DISK_SECTOR || !fits(sectors, 2)) {
+        CLogger::Get()->Write("DISK", LogError, "%s: no memory for the overlay", name) ;
+        f_close(&base) ;
+        return FR_NOT_ENOUGH_CORE ;
+    }
+
+    data = new u8[sectors * DISK_SECTOR] ;
+    dirty = new u32[words] ;
+    cow = new u32[words] ;
+    memset(data, 0, sectors * DISK_SECTOR) ;
+    memset(dirty, 0, words * sizeof(u32)) ;
+    memset(cow, 0, words * sizeof(u32)) ;
+
+    UINT br ;
+    fr = f_read(&base, data, f_size(&base), &br) ;
+    f_close(&base) ;
+    if (FR_OK != fr) {
+        CLogger::Get()->Write("DISK", LogError, "%s: read error %d", name, fr) ;
+    }
+
+    fr = f_open(&file, delta, FA_READ | FA_WRITE | FA_OPEN_ALWAYS) ;
+    if (FR_OK != fr) {
+        CLogger::Get()->Write("DISK", LogError, "%s: cannot open the delta: %d", delta, fr) ;
+        release() ;
+        return fr ;
+    }
+    opened = true ;
+
+    CowHeader h ;
+    bool valid = !revert && f_size(&file) >= cowoff
+        && FR_OK == f_read(&file, &h, sizeof(h), &br) && br == sizeof(h)
+        && memcmp(h.magic, COW_MAGIC, sizeof(h.magic)) == 0 && h.sectors == sectors
+        && FR_OK == f_lseek(&file, DISK_SECTOR) && FR_OK == f_read(&file, cow, words * sizeof(u32), &br) && br == words * sizeof(u32) ;
+
+    if (!valid) {
+        if (truncate()) {
+            CLogger::Get()->Write("DISK", LogNotice, "%s: empty over %s", delta, name) ;
+        } else {
+            CLogger::Get()->Write("DISK", LogError, "%s: could not start the delta", delta) ;
+        }
+    } else {
+        u32 n = 0 ;
+        for (u32 s = 0; s < sectors; s++) {
+            if (!(cow[s >> 5] & (1u << (s & 31)))) {
+                continue ;
+            }
+            u32 e = s + 1 ;
+            while (e < sectors && (cow[e >> 5] & (1u << (e & 31)))) {
+                e++ ;
+            }
+            if (FR_OK != f_lseek(&file, cowoff + s * DISK_SECTOR) || FR_OK != f_read(&file, data + s * DISK_SECTOR, (e - s) * DISK_SECTOR, &br)) {
+                CLogger::Get()->Write("DISK", LogError, "%s: read error, sectors %u-%u", delta, s, e - 1) ;
+            }
+            n += e - s ;
+            s = e ;
+        }
+        CLogger::Get()->Write("DISK", LogNotice, "%s: %u sectors over %s", delta, n, name) ;
+    }
+
+    next = images ;
+    __atomic_store_n(&images, this, __ATOMIC_RELEASE) ; // core 3 walks the list
+
+    return FR_OK ;
+}
+
+// release gives the RAM copy and the bitmaps back, when an open fails after they were taken
+void DiskImage::release() {
+    delete [] data ;
+    delete [] dirty ;
+    delete [] cow ;
+    data = 0 ;
+    dirty = 0 ;
+    cow = 0 ;
+}
+
+// truncate empties the delta down to its header and a clear bitmap
+bool DiskImage::truncate() {
+    u32 words = (sectors + 31) / 32 ;
+    memset(cow, 0, words * sizeof(u32)) ;
+
+    CowHeader h ;
+    memset(&h, 0, sizeof(h)) ;
+    memcpy(h.magic, COW_MAGIC, sizeof(h.magic)) ;
+    h.sectors = sectors ;
+
+    UINT bw ;
+    bool ok = FR_OK == f_lseek(&file, 0) && FR_OK == f_truncate(&file)
+        && FR_OK == f_write(&file, &h, sizeof(h), &bw)
+        && FR_OK == f_lseek(&file, DISK_SECTOR) && FR_OK == f_write(&file, cow, words * sizeof(u32), &bw)
+        && FR_OK == f_lseek(&file, cowoff) && f_tell(&file) == cowoff ;
+
+    f_sync(&file) ;
+    return ok ;
+}
+
+void DiskImage::poll(const u64 now) {
+    if (!pending) {
+        return ;
+    }
+
+    switch (sync) {
+        case SYNC_INTERVAL:
+            if (now - flushed >= (every ? every : interval) * 1000ull) {
+                flush() ;
+            }
+            break ;
+        case SYNC_IDLE:
+            if (now - written >= DISK_IDLE_TIME * 1000ull) {
+                flush() ;
+            }
+            break ;
+        default:    // SYNC_ALWAYS is done in write(), SYNC_SHUTDOWN waits for flushall()
+            break ;
+    }
+}
+
+bool DiskImage::setsync(const char *policy) {
+    if (strcmp(policy, "always") == 0) {
+        sync = SYNC_ALWAYS ;
+    } else if (strncmp(policy, "interval=", 9) == 0 && atoi(policy + 9) > 0) {
+        sync = SYNC_INTERVAL ;
+        every = atoi(policy + 9) ;
+    } else if (strcmp(policy, "on-idle") == 0) {
+        sync = SYNC_IDLE ;
+    } else if (strcmp(policy, "on-shutdown") == 0) {
+        sync = SYNC_SHUTDOWN ;
+    } else {
+        return false ;
+    }
+
+    return true ;
+}
+
+void DiskImage::pollall(const u64 now) {
+    for (DiskImage *d = images; d; d = d->next) {
+        d->poll(now) ;
+    }
+}
+
+void DiskImage::flushall() {
+    for (DiskImage *d = images; d; d = d->next) {
+        d->flush() ;
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <circle/types.h>
+#include <circle/spinlock.h>
+#include <fatfs/ff.h>
+
+#define DISK_SECTOR 512
+
+#define RK05_SIZE (203 * 2 * 12 * DISK_SECTOR)
+#define RL02_SIZE (512 * 2 * 40 * 256)
+
+#define DISK_FLUSH_INTERVAL 1000 // default ms between background write-backs
+#define DISK_IDLE_TIME 500       // ms without writes before an on-idle drive is written back
+#define DISK_POLL 10             // ms between looks at the sync policies
+#define DISK_RESERVE (32 << 20)  // heap left to the rest of the system when an image is cached
+#define DISK_CACHE_MAX (256 << 20) // larger images, RA81 and up, are not held in RAM
+#define DISK_CHUNK 8192          // most sectors given to disk_read() or disk_write() at once
+
+// DiskSync, when the writes to an image reach the card, SYNC= in CONFIG.INI
+enum DiskSync : u8 {
+    SYNC_ALWAYS,    // always, each write goes straight through
+    SYNC_INTERVAL,  // interval=N, every N ms
+    SYNC_IDLE,      // on-idle, once the drive has been quiet for DISK_IDLE_TIME
+    SYNC_SHUTDOWN   // on-shutdown, only when the emulator stops
+};
+
+/*
+ * A disk image held in RAM. The whole file is read on open, transfers are
+ * served by memcpy and every written sector is marked dirty. flush() writes
+ * the dirty sectors back to the SD card, poll() calls it from core 3 as the
+ * sync policy asks and flushall() once more at shutdown. An image larger
+ * than DISK_CACHE_MAX, or one there is no memory for, is read and written
+ * on the card directly, then only the f_sync is put off. It goes by LBA as
+ * well when it is contiguous, through a cluster link map when it is not.
+ *
+ * An image whose clusters lie in one run on the card is loaded and written
+ * back by LBA through disk_read() and disk_write(), FatFs only opens it.
+ * CONTIG=ON lays fragmented images out again on open, new ones are made
+ * contiguous with f_expand().
+ *
+ * With an overlay set before open() the file named there is only read, as the
+ * base. Written sectors go to the delta file behind a header and a sector
+ * bitmap, and on open the sectors the bitmap marks are laid over the base.
+ * Going back to the base truncates the delta, nothing of the base is copied.
+ */
+class DiskImage {
+    public:
+        DiskImage() ;
+
+        FRESULT open(const char *name, const u32 capacity, const bool create = false) ;
+        void close() ;
+        inline bool isopen() { return opened ; }
+
+        bool read(const u32 pos, void *buf, const u32 len) ;
+        bool write(const u32 pos, const void *buf, const u32 len) ;
+
+        void flush() ;
+        static void flushall() ;
+        static void pollall(const u64 now) ;
+        static u32 interval ; // ms between background write-backs, FLUSH= in CONFIG.INI
+        static bool contig ;  // relay fragmented images, CONTIG=ON in CONFIG.INI
+
+        // setsync takes always, interval=N, on-idle or on-shutdown
+        bool setsync(const char *policy) ;
+
+        // overlay makes the image copy-on-write into delta, reset drops what the delta held
+        void overlay(const char *delta, const bool reset) ;
+
+        u32 size ;
+
+    private:
+        FIL file ;
+        bool opened ;
+        u8 *data ;
+        u32 *dirty ;    // one bit per sector
+        u32 sectors ;
+        CSpinLock lock ; // flushes may come from two cores at shutdown
+
+        DiskSync sync ;
+        u32 every ;      // ms for SYNC_INTERVAL, 0 takes interval
+        bool pending ;   // written since the last flush
+        u64 flushed ;    // when, in us
+        u64 written ;
+
+        LBA_t lba ;      // first sector of a contiguous image on the card, 0 goes through FatFs
+        DWORD *clmt ;    // cluster link map of a fragmented image left on the card
+        u8 bounce[DISK_SECTOR] __attribute__ ((aligned (4))) ; // a partial sector of an image left on the card, the card driver takes words
+
+        const char *delta ; // file the writes go to, 0 writes the image itself
+        bool revert ;       // start the delta afresh on open
+        u32 *cow ;          // one bit per sector held in the delta
+        u32 cowoff ;        // where the sectors start in the delta
+
+        void poll(const u64 now) ;
+        LBA_t locate() ;
+        void direct() ;
+        bool lbarw(u32 pos, u8 *buf, u32 len, const bool w) ;
+        bool relay(const char *name) ;
+        FRESULT opencow(const char *name, const u32 capacity) ;
+        bool truncate() ;
+        void release() ;
+
+        DiskImage *next ;
+        static DiskImage *images ;
+} ;
@@ -73,6 +73,7 @@ void DL11::write16(const u32 a, const u16 v) {
 			xbuf = v & 0177;
 			xbuf |= 0200; // Allow for nulls !!!!
 			xcsr &= ~0200;
+			cpu.events.schedule(EV_DL, 1) ;
 			break;
 		default:
 			gprintf("Dl11: write to invalid address %06o\n", a);
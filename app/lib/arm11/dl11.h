@@ -13,6 +13,7 @@ class DL11 : public XX11 {
         void clearterminal();
         void xpoll();
         void rpoll();
+        inline bool xbusy() { return !(xcsr & 0200); }
         virtual u16 read16(const u32 a);
         virtual void write16(const u32 a, const u16 v);
 
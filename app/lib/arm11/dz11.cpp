@@ -0,0 +1,261 @@
+#include "dz11.h"
+
+#include <circle/logger.h>
+#include "arm11.h"
+#include "kb11.h"
+
+extern KB11 cpu;
+
+// CSR bits
+#define DZ_MAINT 0000010
+#define DZ_CLR   0000020
+#define DZ_MSE   0000040
+#define DZ_RIE   0000100
+#define DZ_RDONE 0000200
+#define DZ_TLINE 0003400
+#define DZ_SAE   0010000
+#define DZ_SA    0020000
+#define DZ_TIE   0040000
+#define DZ_TRDY  0100000
+
+#define DZ_RXON  0010000 // LPR receiver on
+#define DZ_DVAL  0100000 // RBUF data valid
+
+DZ11::DZ11()
+:   csr(0),
+    tcr(0),
+    silohead(0),
+    silocount(0),
+    scan(0)
+{
+    for (u8 i = 0; i < DZ11_LINES; i++) {
+        lines[i].carrier = false ;
+        lines[i].lpr = 0 ;
+    }
+}
+
+u16 DZ11::read16(u32 a) {
+    switch (a) {
+        case DZ11_CSR:
+            return csr ;
+        case DZ11_RBUF: {
+                if (!silocount) {
+                    return 0 ;
+                }
+
+                const u16 v = silo[silohead] ;
+                silohead = (silohead + 1) % DZ11_SILO ;
+                silocount-- ;
+
+                if (silocount < DZ11_ALARM) {
+                    csr &= ~DZ_SA ;
+                }
+                if (!silocount) {
+                    csr &= ~DZ_RDONE ;
+                    cpu.clearIRQ(INTDZR) ;
+                }
+                return v ;
+            }
+        case DZ11_TCR:
+            return tcr ;
+        case DZ11_MSR: {
+                u16 co = 0 ;
+                for (u8 i = 0; i < DZ11_LINES; i++) {
+                    if (__atomic_load_n(&lines[i].carrier, __ATOMIC_ACQUIRE)) {
+                        co |= 0400 << i ;
+                    }
+                }
+                return co ;
+            }
+
+        default:
+            CLogger::Get()->Write("DZ11", LogError, "read16 non-existent address %08o", a) ;
+            cpu.errorRegister = 020 ;
+            trap(INTBUS);
+    }
+
+    return 0 ;
+}
+
+void DZ11::write16(u32 a, u16 v) {
+    switch (a) {
+        case DZ11_CSR:
+            if (v & DZ_CLR) {
+                clear() ;
+                break ;
+            }
+
+            csr = (csr & ~(DZ_TIE | DZ_SAE | DZ_RIE | DZ_MSE | DZ_MAINT)) | (v & (DZ_TIE | DZ_SAE | DZ_RIE | DZ_MSE | DZ_MAINT)) ;
+            if (csr & DZ_MSE) {
+                cpu.events.schedule(EV_DZ, 1) ;
+            } else {
+                csr &= ~DZ_TRDY ;
+            }
+
+            if ((csr & DZ_RIE) && (csr & ((csr & DZ_SAE) ? DZ_SA : DZ_RDONE))) {
+                cpu.interrupt(INTDZR, 5) ;
+            } else {
+                cpu.clearIRQ(INTDZR) ;
+            }
+            if ((csr & DZ_TIE) && (csr & DZ_TRDY)) {
+                cpu.interrupt(INTDZT, 5) ;
+            } else {
+                cpu.clearIRQ(INTDZT) ;
+            }
+            break ;
+
+        case DZ11_RBUF:
+            lines[v & 7].lpr = v ;
+            break ;
+
+        case DZ11_TCR:
+            tcr = v ;
+            if (csr & DZ_MSE) {
+                cpu.events.schedule(EV_DZ, 1) ;
+            }
+            break ;
+
+        case DZ11_MSR:
+            if (csr & DZ_TRDY) {
+                DZLine &l = lines[(csr & DZ_TLINE) >> 8] ;
+                if (__atomic_load_n(&l.carrier, __ATOMIC_ACQUIRE)) {
+                    l.tx.put(v & 0377) ;
+                }
+                csr &= ~DZ_TRDY ;
+                cpu.clearIRQ(INTDZT) ;
+                cpu.events.schedule(EV_DZ, 1) ; // the scanner moves on at once
+            }
+            break ;
+
+        default:
+            CLogger::Get()->Write("DZ11", LogError, "write16 non-existent address %08o : %06o", a, v) ;
+            cpu.errorRegister = 020 ;
+            trap(INTBUS);
+    }
+}
+
+void DZ11::clear() {
+    csr = tcr = 0 ;
+    silohead = silocount = 0 ;
+    scan = 0 ;
+    for (u8 i = 0; i < DZ11_LINES; i++) {
+        lines[i].lpr = 0 ;
+    }
+    cpu.clearIRQ(INTDZR) ;
+    cpu.clearIRQ(INTDZT) ;
+}
+
+void DZ11::reset() {
+    clear() ;
+}
+
+// busy tells if the scan has work: a line to offer while TRDY is clear, or input to take
+bool DZ11::busy() {
+    if (!(csr & DZ_MSE)) {
+        return false ;
+    }
+
+    // with TRDY up the guest has to write TDR, that rearms the scan itself
+    if (!(csr & DZ_TRDY) && (tcr & 0377)) {
+        return true ;
+    }
+
+    return pending() ;
+}
+
+// pending tells if a line has input the scan has not taken yet, the host clock polls it
+bool DZ11::pending() {
+    if (!(csr & DZ_MSE)) {
+        return false ;
+    }
+
+    for (u8 i = 0; i < DZ11_LINES; i++) {
+        if (!lines[i].rx.empty()) {
+            return true ;
+        }
+    }
+
+    return false ;
+}
+
+void DZ11::step() {
+    if (!(csr & DZ_MSE)) {
+        return ;
+    }
+
+    receive() ;
+    transmit() ;
+}
+
+// receive moves what came in into the silo, a character of each line in turn
+void DZ11::receive() {
+    bool more = true ;
+    while (more && silocount < DZ11_SILO) {
+        more = false ;
+        for (u8 i = 0; i < DZ11_LINES && silocount < DZ11_SILO; i++) {
+            u8 c ;
+            if (!lines[i].rx.get(c)) {
+                continue ;
+            }
+            more = true ;
+            if (lines[i].lpr & DZ_RXON) {
+                silo[(silohead + silocount++) % DZ11_SILO] = DZ_DVAL | (i << 8) | c ;
+            }
+        }
+    }
+
+    if (!silocount) {
+        return ;
+    }
+
+    const u16 was = csr ;
+    csr |= DZ_RDONE ;
+    if (silocount >= DZ11_ALARM) {
+        csr |= DZ_SA ;
+    }
+
+    // with the silo alarm on only every DZ11_ALARM characters interrupt
+    const u16 bit = (csr & DZ_SAE) ? DZ_SA : DZ_RDONE ;
+    if ((csr & DZ_RIE) && (csr & bit) && !(was & bit)) {
+        cpu.interrupt(INTDZR, 5) ;
+    }
+}
+
+// transmit offers the next enabled line with room, lines without a connection take and lose everything
+void DZ11::transmit() {
+    if (csr & DZ_TRDY) {
+        return ;
+    }
+
+    for (u8 n = 0; n < DZ11_LINES; n++) {
+        const u8 i = (scan + n) % DZ11_LINES ;
+        if (!(tcr & (1 << i))) {
+            continue ;
+        }
+        if (__atomic_load_n(&lines[i].carrier, __ATOMIC_ACQUIRE) && !lines[i].tx.room()) {
+            continue ;
+        }
+
+        scan = (i + 1) % DZ11_LINES ;
+        csr = (csr & ~DZ_TLINE) | (i << 8) | DZ_TRDY ;
+        if (csr & DZ_TIE) {
+            cpu.interrupt(INTDZT, 5) ;
+        }
+        return ;
+    }
+}
+
+int DZ11::connect() {
+    for (u8 i = 0; i < DZ11_LINES; i++) {
+        if (!__atomic_load_n(&lines[i].carrier, __ATOMIC_ACQUIRE)) {
+            __atomic_store_n(&lines[i].carrier, true, __ATOMIC_RELEASE) ;
+            return i ;
+        }
+    }
+
+    return -1 ;
+}
+
+void DZ11::hangup(const u8 line) {
+    __atomic_store_n(&lines[line].carrier, false, __ATOMIC_RELEASE) ;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <circle/types.h>
+#include "ring.h"
+#include "xx11.h"
+
+#define DZ11_CSR 017760100
+#define DZ11_RBUF 017760102 // LPR when written
+#define DZ11_TCR 017760104
+#define DZ11_MSR 017760106  // TDR when written
+
+#define DZ11_LINES 8
+#define DZ11_SILO 64   // characters the receive silo holds
+#define DZ11_ALARM 16  // silo alarm level
+#define DZ11_RING 2048 // bytes each way between a line and its connection
+#define DZ11_DELAY 64  // iterations between scans of the lines
+
+struct DZLine {
+    ByteRing<DZ11_RING> rx ; // from the connection, the telnet task puts and the emulator takes
+    ByteRing<DZ11_RING> tx ; // to the connection, the other way round
+    bool carrier ;           // a connection is up, set and cleared by the telnet task
+    u16 lpr ;
+} ;
+
+/*
+ * DZ11 eight line asynchronous multiplexer. Received characters of all lines
+ * go through one 64 character silo, with the silo alarm on the guest takes an
+ * interrupt only every 16 of them. The transmitter scanner offers the next
+ * enabled line that has room whenever TDR has been written. The lines are
+ * served by the telnet server on core 0 through a pair of rings each.
+ */
+class DZ11 : public XX11 {
+    public:
+        DZ11() ;
+
+        virtual u16 read16(u32 a) ;
+        virtual void write16(u32 a, u16 v) ;
+        void reset() ;
+        void step() ;
+        bool busy() ;
+        bool pending() ;
+
+        // connect takes a free line for a new connection, -1 when all are in use
+        int connect() ;
+        void hangup(const u8 line) ;
+
+        DZLine lines[DZ11_LINES] ;
+    private:
+        u16 csr, tcr ;
+        u16 silo[DZ11_SILO] ;
+        u8 silohead, silocount ;
+        u8 scan ;   // line the transmitter scanner looks at first
+
+        void clear() ;
+        void receive() ;
+        void transmit() ;
+} ;
@@ -0,0 +1,53 @@
+#include "event.h"
+
+#define EV_NEVER (~0ull)
+
+EventQueue::EventQueue() {
+    reset() ;
+}
+
+void EventQueue::reset() {
+    for (int i = 0; i < EV_COUNT; i++) {
+        when[i] = EV_NEVER ;
+    }
+    next = EV_NEVER ;
+}
+
+void EventQueue::schedule(const EventID id, const u32 delay) {
+    when[id] = now + delay ;
+    if (when[id] < next) {
+        next = when[id] ;
+    }
+}
+
+void EventQueue::cancel(const EventID id) {
+    // next is left alone, expired() recalculates it when it finds nothing due
+    when[id] = EV_NEVER ;
+}
+
+EventID EventQueue::expired() {
+    u64 n = EV_NEVER ;
+
+    for (int i = 0; i < EV_COUNT; i++) {
+        if (when[i] <= now) {
+            when[i] = EV_NEVER ;
+            return (EventID) i ;
+        }
+        if (when[i] < n) {
+            n = when[i] ;
+        }
+    }
+
+    next = n ;
+    return EV_COUNT ;
+}
+
+bool EventQueue::idle() const {
+    for (int i = 0; i < EV_COUNT; i++) {
+        if ((when[i] != EV_NEVER) != (i == EV_HOST)) {
+            return false ;
+        }
+    }
+
+    return true ;
+}
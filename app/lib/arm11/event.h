@@ -0,0 +1,60 @@
+#pragma once
+
+#include <circle/types.h>
+
+// Things loop() has to do later, in the order hw_step() used to poll them.
+// Time is counted in loop() iterations, one per emulated instruction or WAIT spin.
+enum EventID : u8 {
+    EV_RK,
+    EV_RL,
+    EV_TC,
+    EV_RH,
+    EV_UDA,
+    EV_PTR,
+    EV_PTP,
+    EV_LP,
+    EV_PIRQ,
+    EV_KL,   // console transmitter
+    EV_KLR,  // console receiver, the next character waiting on the ring
+    EV_DL,   // second terminal transmitter
+    EV_DZ,   // multiplexer scan
+    EV_HOST, // host clock: KW11 line and programmable clock, terminal input
+    EV_TOY,
+    EV_COUNT
+} ;
+
+#define EV_HOST_PERIOD 16
+
+class EventQueue {
+    public:
+        EventQueue() ;
+
+        // schedule (re)arms id to fire delay iterations from now, delay >= 1
+        void schedule(const EventID id, const u32 delay) ;
+        void cancel(const EventID id) ;
+        void reset() ;
+
+        // tick advances the clock by one iteration and tells if anything is due
+        inline bool tick() {
+            return ++now >= next ;
+        }
+
+        // expired disarms and returns the first due event, EV_COUNT when none is left
+        EventID expired() ;
+
+        // idle tells if the host clock is the only thing armed, a WAIT may nap until it is due
+        bool idle() const ;
+
+        // skip moves the clock up to just before the next due event
+        inline void skip() {
+            if (next > now) {
+                now = next - 1 ;
+            }
+        }
+
+        u64 now = 0 ;
+
+    private:
+        u64 when[EV_COUNT] ;
+        u64 next ;
+} ;
@@ -0,0 +1,61 @@
+#include "feed.h"
+
+TextFeed::TextFeed()
+:   first(0),
+    last(0),
+    spare(0),
+    n(0)
+{
+}
+
+bool TextFeed::put(const u8 c) {
+    if (n >= FEED_MAX) {
+        return false ;
+    }
+
+    if (!last || last->tail == FEED_CHUNK) {
+        FeedChunk *k = spare ;
+        if (k) {
+            spare = 0 ;
+        } else {
+            k = new FeedChunk ;
+        }
+        k->next = 0 ;
+        k->head = k->tail = 0 ;
+
+        if (last) {
+            last->next = k ;
+        } else {
+            first = k ;
+        }
+        last = k ;
+    }
+
+    last->data[last->tail++] = c ;
+    n++ ;
+    return true ;
+}
+
+bool TextFeed::get(u8 &c) {
+    if (!n) {
+        return false ;
+    }
+
+    c = first->data[first->head++] ;
+    n-- ;
+
+    if (first->head == first->tail && (first->tail == FEED_CHUNK || !n)) {
+        FeedChunk *k = first ;
+        first = k->next ;
+        if (!first) {
+            last = 0 ;
+        }
+        if (spare) {
+            delete k ;
+        } else {
+            spare = k ;
+        }
+    }
+
+    return true ;
+}
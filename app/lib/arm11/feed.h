@@ -0,0 +1,34 @@
+#pragma once
+
+#include <circle/types.h>
+
+#define FEED_CHUNK 4096 // bytes a piece of the feed holds
+#define FEED_MAX (16 * FEED_CHUNK) // most bytes the feed takes
+
+struct FeedChunk {
+    FeedChunk *next ;
+    u32 head, tail ;
+    u8 data[FEED_CHUNK] ;
+} ;
+
+/*
+ * Text waiting for a terminal input of the guest. The feed grows a chunk at
+ * a time up to FEED_MAX, so a paste is kept whole while the guest takes it
+ * one character at a time. Emptied chunks are kept for reuse. Only the
+ * emulator core touches it.
+ */
+class TextFeed {
+    public:
+        TextFeed() ;
+
+        bool put(const u8 c) ;
+        bool get(u8 &c) ;
+        inline u32 count() { return n ; }
+        inline u32 room() { return FEED_MAX - n ; }
+        inline bool empty() { return n == 0 ; }
+
+    private:
+        FeedChunk *first, *last ;
+        FeedChunk *spare ;
+        u32 n ;
+} ;
@@ -0,0 +1,56 @@
+#include "ioengine.h"
+
+#include <circle/synchronize.h>
+#include <circle/timer.h>
+
+bool IOEngine::latency = false ;
+
+u64 IOEngine::due(const DiskTiming &t, const u32 dcyl, const u32 sector, const u32 n) {
+    u64 when = CTimer::GetClockTicks64() ;
+    if (dcyl) {
+        when += t.settle + (dcyl - 1) * t.step ;
+    }
+
+    // wait for the sector to come round, the platter turns on while the arm moves
+    const u32 at = (when / t.sector) % t.spt ;
+    when += ((sector + t.spt - at) % t.spt + n) * t.sector ;
+    return when ;
+}
+
+bool IOEngine::post(const IORequest &r) {
+    if (!room()) {
+        return false ;
+    }
+
+    req[reqhead & (IO_RING - 1)] = r ;
+    __atomic_store_n(&reqhead, reqhead + 1, __ATOMIC_RELEASE) ;
+    SendEvent() ; // wake core 3
+    return true ;
+}
+
+bool IOEngine::done(IORequest &r) {
+    if (!completed()) {
+        return false ;
+    }
+
+    r = cmp[cmptail & (IO_RING - 1)] ;
+    __atomic_store_n(&cmptail, cmptail + 1, __ATOMIC_RELEASE) ;
+    return true ;
+}
+
+bool IOEngine::serve() {
+    const u32 t = reqtail ;
+    if (t == __atomic_load_n(&reqhead, __ATOMIC_ACQUIRE)) {
+        return false ;
+    }
+
+    IORequest &r = req[t & (IO_RING - 1)] ;
+
+    r.ok = r.op == IO_WRITE ? r.disk->write(r.pos, r.buf, r.len) : r.disk->read(r.pos, r.buf, r.len) ;
+
+    // the request slot is handed back only after its completion is visible
+    cmp[cmphead & (IO_RING - 1)] = r ;
+    __atomic_store_n(&cmphead, cmphead + 1, __ATOMIC_RELEASE) ;
+    __atomic_store_n(&reqtail, t + 1, __ATOMIC_RELEASE) ;
+    return true ;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <circle/types.h>
+#include "disk.h"
+#include "event.h"
+
+#define IO_RING 64 // entries per ring, a power of two
+
+enum IOOp : u8 {
+    IO_READ,
+    IO_WRITE
+} ;
+
+// An IORequest moves len bytes between buf and pos of a disk image.
+// owner names the controller the completion goes back to, tag what for.
+struct IORequest {
+    DiskImage *disk ;
+    u32 pos ;
+    void *buf ;
+    u32 len ;
+    IOOp op ;
+    EventID owner ;
+    bool ok ;
+    u8 tag ;
+} ;
+
+// Mechanical timing of a drive type, all times in us
+struct DiskTiming {
+    u32 settle ; // seek to the next cylinder
+    u32 step ;   // each further cylinder
+    u32 spt ;    // sectors per track
+    u32 sector ; // one sector passing under the head
+} ;
+
+const DiskTiming RK05_TIMING = {10000, 375, 12, 3333} ; // 1500 rpm, 85 ms full stroke
+const DiskTiming RL02_TIMING = {15000, 166, 40, 625} ;  // 2400 rpm, 100 ms full stroke
+const DiskTiming RP06_TIMING = {7000, 59, 22, 758} ;    // 3600 rpm, 55 ms full stroke
+const DiskTiming RM05_TIMING = {6000, 60, 32, 521} ;    // 3600 rpm, 55 ms full stroke
+const DiskTiming RA81_TIMING = {6000, 40, 51, 327} ;    // 3600 rpm, 55 ms full stroke
+
+/*
+ * Disk transfers run on core 3. The emulator core posts requests, core 3
+ * serves them in order and posts the completions back. Both rings have a
+ * single producer and a single consumer, so head and tail are the only
+ * shared state and no lock is taken.
+ */
+class IOEngine {
+    public:
+        // core 1 side
+        bool post(const IORequest &r) ;
+        bool done(IORequest &r) ;
+        // room counts requests until a completion has been taken back with done()
+        inline u32 room() {
+            return IO_RING - (reqhead - cmptail) ;
+        }
+        inline bool idle() {
+            return __atomic_load_n(&reqtail, __ATOMIC_ACQUIRE) == reqhead ;
+        }
+        inline bool completed() {
+            return __atomic_load_n(&cmphead, __ATOMIC_ACQUIRE) != cmptail ;
+        }
+
+        // core 3 side, serve runs one request and tells if there was any
+        bool serve() ;
+
+        static bool latency ; // model seek and rotation time, LATENCY=ON in CONFIG.INI
+
+        // due is the host time a transfer of n sectors from sector, dcyl cylinders away, is through
+        static u64 due(const DiskTiming &t, const u32 dcyl, const u32 sector, const u32 n) ;
+
+    private:
+        IORequest req[IO_RING] ;
+        IORequest cmp[IO_RING] ;
+        u32 reqhead = 0, reqtail = 0 ;
+        u32 cmphead = 0, cmptail = 0 ;
+} ;
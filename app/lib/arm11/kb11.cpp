@@ -26,6 +26,14 @@ KB11::KB11() {
     for (int i = 0; i < 128; i++) {
         irqs[i] = 0 ;
     }
+
+    for (int l = 0; l < 8; l++) {
+        for (int w = 0; w < 4; w++) {
+            irqmap[l][w] = 0 ;
+        }
+    }
+
+    buildOpTable() ;
 }
 
 void KB11::reset(u16 start) {
@@ -36,6 +44,7 @@ void KB11::reset(u16 start) {
     mmu.reset() ;
     unibus.reset(false);
     wtstate = false;
+    trapreq = 0 ;
     errorRegister = 0 ;
 }
 
@@ -48,6 +57,7 @@ u16 KB11::read16(const u32 a) {
         ldat = a ;
         switch (a) {
             case 017777776:
+                flags() ;
                 return PSW;
             case 017777774:
                 return stacklimit;
@@ -115,6 +125,7 @@ void KB11::write16(const u32 a, const u16 v) {
                 }
 
                 pirqr |= pia ;
+                events.schedule(EV_PIRQ, 1) ;
             }
             break ;
         case 017777776:
@@ -167,14 +178,7 @@ void KB11::ADD(const u16 instr) {
     const bool dpage = denabled() && op.operandType == OPERAND_DATA ;
     const auto dst = read<2>(op.operand, dpage, false);
     const auto sum = src + dst;
-    PSW &= 0xFFF0;
-    setNZ<2>(sum);
-    if (((~src ^ dst) & (src ^ sum)) & 0x8000) {
-        PSW |= PSW_BIT_V;
-    }
-    if ((s32(src) + s32(dst)) > 0xFFFF) {
-        PSW |= PSW_BIT_C;
-    }
+    lazyCC<2>(CC_ADD, sum, src, dst) ;
     write<2>(op.operand, sum, dpage);
     datapath = sum ;
 }
@@ -189,14 +193,7 @@ void KB11::SUB(const u16 instr) {
     const bool dpage = denabled() && op.operandType == OPERAND_DATA ;
     const auto val2 = read<2>(op.operand, dpage, false);
     const auto uval = (val2 - val1) & 0xFFFF;
-    PSW &= 0xFFF0;
-    setNZ<2>(uval);
-    if (((val1 ^ val2) & (~val1 ^ uval)) & 0x8000) {
-        PSW |= PSW_BIT_V;
-    }
-    if (val1 > val2) {
-        PSW |= PSW_BIT_C;
-    }
+    lazyCC<2>(CC_SUB, uval, val2, val1) ;
     write<2>(op.operand, uval, dpage);
     datapath = uval ;
 }
@@ -611,6 +608,249 @@ void KB11::SXT(const u16 instr) {
     }
 }
 
+void KB11::HALT() {
+    if (currentmode()) {
+        errorRegister = 0200 ;
+        trap(INTBUS);
+    }
+    // Console::get()->printf(" HALT:\r\n");
+    // printstate();
+    datapath = RR[REG(0)] ;
+    cpuStatus = CPU_STATUS_HALT ;
+}
+
+// SPL 00023N
+void KB11::SPL(const u16 instr) {
+    if (currentmode()) {
+        return ;
+    }
+    PSW = ((PSW & 0177037) | ((instr & 7) << 5));
+    wasSPL = true ;
+}
+
+// CLR CC 00024C, 00025C
+void KB11::CCC(const u16 instr) {
+    PSW = (PSW & ~(instr & 017));
+}
+
+// SET CC 00026C, 00027C
+void KB11::SCC(const u16 instr) {
+    PSW = (PSW | (instr & 017));
+}
+
+// BPT 000003
+void KB11::BPT() {
+    trapreq = INTDEBUG ; // Trap 14 - BPT
+}
+
+// IOT 000004
+void KB11::IOT() {
+    trapreq = INTIOT ;
+}
+
+// EMT 104xxx
+void KB11::EMT() {
+    trapreq = INTEMT ; // Trap 30 - EMT instruction
+}
+
+// TRAP 1044xx
+void KB11::TRAP() {
+    trapreq = INTTRAP ; // Trap 34 - TRAP instruction
+}
+
+// 17xxxx FPP instructions
+void KB11::FPP(const u16 instr) {
+    fp11(instr);
+}
+
+void KB11::INVAL() {
+    trapreq = INTINVAL ;
+}
+
+void KB11::evalflags() {
+    const u16 msbv = (ccop & CC_BYTE) ? 0200 : 0100000 ;
+    const u16 res = ccres & ((msbv << 1) - 1) ;
+    u16 cc = 0 ;
+
+    if (res & msbv) {
+        cc |= PSW_BIT_N ;
+    }
+    if (res == 0) {
+        cc |= PSW_BIT_Z ;
+    }
+
+    switch (ccop & ~CC_BYTE) {
+        case CC_INC:
+            if (res == msbv) {
+                cc |= PSW_BIT_V ;
+            }
+            cc |= PSW & PSW_BIT_C ;
+            break ;
+        case CC_DEC:
+            if (res == msbv - 1) {
+                cc |= PSW_BIT_V ;
+            }
+            cc |= PSW & PSW_BIT_C ;
+            break ;
+        case CC_ADD:
+            if ((~cca ^ ccb) & (cca ^ res) & msbv) {
+                cc |= PSW_BIT_V ;
+            }
+            if (res < cca) {
+                cc |= PSW_BIT_C ;
+            }
+            break ;
+        case CC_SUB:
+            if ((cca ^ ccb) & ~(ccb ^ res) & msbv) {
+                cc |= PSW_BIT_V ;
+            }
+            if (cca < ccb) {
+                cc |= PSW_BIT_C ;
+            }
+            break ;
+        case CC_TST:
+            break ;
+        default: // CC_NZ
+            cc |= PSW & PSW_BIT_C ;
+            break ;
+    }
+
+    PSW = (PSW & PSW_MASK_COND) | cc ;
+    ccop = CC_NONE ;
+}
+
+KB11::KB11Op KB11::optable[65536] ;
+u8 KB11::optime[65536] ;
+
+/*
+ * Every instruction word is decoded once at startup instead of walking the
+ * nested switch on each step. The first matching entry wins, so the more
+ * specific masks go first. Anything left unmatched traps through 010.
+ *
+ * Each entry also carries the 11/70 execute time in 50 ns ticks, the source
+ * and destination address times for its operands are added per word. The
+ * figures follow the processor handbook timing tables for cache hits and are
+ * rounded, trap service is charged separately by trapat().
+ */
+void KB11::buildOpTable() {
+    enum OpTiming : u8 {
+        OT_NONE,   // no general operand
+        OT_DST,    // one operand in bits 5-0
+        OT_SRCDST  // operands in bits 11-6 and 5-0
+    } ;
+
+    static const u8 srctime[8] = {0, 6, 6, 12, 6, 12, 12, 18} ;
+    static const u8 dsttime[8] = {0, 6, 6, 12, 9, 15, 12, 18} ;
+
+    static const struct {
+        u16 mask ;
+        u16 ins ;
+        KB11Op op ;
+        u8 time ;
+        OpTiming timing ;
+    } ops[] = {
+        {0177777, 0000000, op<&KB11::HALT>, 6, OT_NONE},
+        {0177777, 0000001, op<&KB11::WAIT>, 6, OT_NONE},
+        {0177777, 0000002, op<&KB11::RTI>, 21, OT_NONE},
+        {0177777, 0000003, op<&KB11::BPT>, 6, OT_NONE},
+        {0177777, 0000004, op<&KB11::IOT>, 6, OT_NONE},
+        {0177777, 0000005, op<&KB11::RESET>, 255, OT_NONE},
+        {0177777, 0000006, op<&KB11::RTT>, 21, OT_NONE},
+        {0177700, 0000100, lz<&KB11::JMP>, 6, OT_DST},
+        {0177770, 0000200, lz<&KB11::RTS>, 15, OT_NONE},
+        {0177770, 0000230, op<&KB11::SPL>, 9, OT_NONE},
+        {0177760, 0000240, op<&KB11::CCC>, 6, OT_NONE},
+        {0177760, 0000260, op<&KB11::SCC>, 6, OT_NONE},
+        {0177700, 0000300, op<&KB11::SWAB>, 6, OT_DST},
+        {0177400, 0000400, lz<&KB11::BR>, 6, OT_NONE},
+        {0177400, 0001000, lz<&KB11::BNE>, 6, OT_NONE},
+        {0177400, 0001400, lz<&KB11::BEQ>, 6, OT_NONE},
+        {0177400, 0002000, lz<&KB11::BGE>, 6, OT_NONE},
+        {0177400, 0002400, lz<&KB11::BLT>, 6, OT_NONE},
+        {0177400, 0003000, lz<&KB11::BGT>, 6, OT_NONE},
+        {0177400, 0003400, lz<&KB11::BLE>, 6, OT_NONE},
+        {0177000, 0004000, lz<&KB11::JSR>, 15, OT_DST},
+        {0177700, 0005000, lz<&KB11::CLR<2>>, 6, OT_DST},
+        {0177700, 0005100, op<&KB11::COM<2>>, 6, OT_DST},
+        {0177700, 0005200, lz<&KB11::INC<2>>, 6, OT_DST},
+        {0177700, 0005300, lz<&KB11::_DEC<2>>, 6, OT_DST},
+        {0177700, 0005400, op<&KB11::NEG<2>>, 6, OT_DST},
+        {0177700, 0005500, op<&KB11::_ADC<2>>, 6, OT_DST},
+        {0177700, 0005600, op<&KB11::SBC<2>>, 6, OT_DST},
+        {0177700, 0005700, lz<&KB11::TST<2>>, 6, OT_DST},
+        {0177700, 0006000, op<&KB11::ROR<2>>, 6, OT_DST},
+        {0177700, 0006100, op<&KB11::ROL<2>>, 6, OT_DST},
+        {0177700, 0006200, op<&KB11::ASR<2>>, 6, OT_DST},
+        {0177700, 0006300, op<&KB11::ASL<2>>, 6, OT_DST},
+        {0177700, 0006400, op<&KB11::MARK>, 18, OT_NONE},
+        {0177700, 0006500, op<&KB11::MFPI>, 24, OT_DST},
+        {0177700, 0006600, op<&KB11::MTPI>, 24, OT_DST},
+        {0177700, 0006700, op<&KB11::SXT>, 6, OT_DST},
+        {0170000, 0010000, lz<&KB11::MOV<2>>, 6, OT_SRCDST},
+        {0170000, 0020000, lz<&KB11::CMP<2>>, 6, OT_SRCDST},
+        {0170000, 0030000, lz<&KB11::_BIT<2>>, 6, OT_SRCDST},
+        {0170000, 0040000, lz<&KB11::BIC<2>>, 6, OT_SRCDST},
+        {0170000, 0050000, lz<&KB11::BIS<2>>, 6, OT_SRCDST},
+        {0170000, 0060000, lz<&KB11::ADD>, 6, OT_SRCDST},
+        {0177000, 0070000, op<&KB11::MUL>, 66, OT_DST},
+        {0177000, 0071000, op<&KB11::DIV>, 141, OT_DST},
+        {0177000, 0072000, op<&KB11::ASH>, 30, OT_DST},
+        {0177000, 0073000, op<&KB11::ASHC>, 39, OT_DST},
+        {0177000, 0074000, lz<&KB11::XOR>, 6, OT_DST},
+        {0177000, 0077000, lz<&KB11::SOB>, 9, OT_NONE},
+        {0177400, 0100000, lz<&KB11::BPL>, 6, OT_NONE},
+        {0177400, 0100400, lz<&KB11::BMI>, 6, OT_NONE},
+        {0177400, 0101000, lz<&KB11::BHI>, 6, OT_NONE},
+        {0177400, 0101400, lz<&KB11::BLOS>, 6, OT_NONE},
+        {0177400, 0102000, lz<&KB11::BVC>, 6, OT_NONE},
+        {0177400, 0102400, lz<&KB11::BVS>, 6, OT_NONE},
+        {0177400, 0103000, lz<&KB11::BCC>, 6, OT_NONE},
+        {0177400, 0103400, lz<&KB11::BCS>, 6, OT_NONE},
+        {0177400, 0104000, op<&KB11::EMT>, 6, OT_NONE},
+        {0177400, 0104400, op<&KB11::TRAP>, 6, OT_NONE},
+        {0177700, 0105000, lz<&KB11::CLR<1>>, 6, OT_DST},
+        {0177700, 0105100, op<&KB11::COM<1>>, 6, OT_DST},
+        {0177700, 0105200, lz<&KB11::INC<1>>, 6, OT_DST},
+        {0177700, 0105300, lz<&KB11::_DEC<1>>, 6, OT_DST},
+        {0177700, 0105400, op<&KB11::NEG<1>>, 6, OT_DST},
+        {0177700, 0105500, op<&KB11::_ADC<1>>, 6, OT_DST},
+        {0177700, 0105600, op<&KB11::SBC<1>>, 6, OT_DST},
+        {0177700, 0105700, lz<&KB11::TST<1>>, 6, OT_DST},
+        {0177700, 0106000, op<&KB11::ROR<1>>, 6, OT_DST},
+        {0177700, 0106100, op<&KB11::ROL<1>>, 6, OT_DST},
+        {0177700, 0106200, op<&KB11::ASR<1>>, 6, OT_DST},
+        {0177700, 0106300, op<&KB11::ASL<1>>, 6, OT_DST},
+        {0177700, 0106500, op<&KB11::MFPD>, 24, OT_DST},
+        {0177700, 0106600, op<&KB11::MTPD>, 24, OT_DST},
+        {0170000, 0110000, lz<&KB11::MOV<1>>, 6, OT_SRCDST},
+        {0170000, 0120000, lz<&KB11::CMP<1>>, 6, OT_SRCDST},
+        {0170000, 0130000, lz<&KB11::_BIT<1>>, 6, OT_SRCDST},
+        {0170000, 0140000, lz<&KB11::BIC<1>>, 6, OT_SRCDST},
+        {0170000, 0150000, lz<&KB11::BIS<1>>, 6, OT_SRCDST},
+        {0170000, 0160000, lz<&KB11::SUB>, 6, OT_SRCDST},
+        {0170000, 0170000, op<&KB11::FPP>, 60, OT_DST},
+    } ;
+
+    for (u32 instr = 0; instr < 0200000; instr++) {
+        optable[instr] = op<&KB11::INVAL> ;
+        optime[instr] = 6 ;
+        for (auto &d : ops) {
+            if ((instr & d.mask) == d.ins) {
+                u32 t = d.time ;
+                if (d.timing != OT_NONE) {
+                    t += dsttime[(instr >> 3) & 7] ;
+                }
+                if (d.timing == OT_SRCDST) {
+                    t += srctime[(instr >> 9) & 7] ;
+                }
+                optable[instr] = d.op ;
+                optime[instr] = t > 255 ? 255 : t ;
+                break ;
+            }
+        }
+    }
+}
+
 void KB11::step() {
     PC = RR[7];
     rflag = 0;
@@ -620,374 +860,31 @@ void KB11::step() {
     if (!(mmu.SR[0] & 0160000)) {
         mmu.SR[2] = PC;
     }
-    
-    switch (instr >> 12) {    // xxSSDD Mostly double operand instructions
-        case 0:                   // 00xxxx mixed group
-            switch (instr >> 8) { // 00xxxx 8 bit instructions first (branch & JSR)
-                case 0:               // 000xXX Misc zero group
-                    switch (instr >> 6) { // 000xDD group (4 case full decode)
-                        case 0:               // 0000xx group
-                            switch (instr) {
-                                case 0: // HALT 000000
-                                    if (currentmode()) {
-                            			errorRegister = 0200 ;
-                                        trap(INTBUS);
-                                    }
-                                    // Console::get()->printf(" HALT:\r\n");
-                                    // printstate();
-                                    datapath = RR[REG(0)] ;
-                                    cpuStatus = CPU_STATUS_HALT ;
-                                    return ;
-                                case 1: // WAIT 000001
-                                    WAIT();
-                                    return;
-                                case 3:          // BPT  000003
-                                    trap(INTDEBUG); // Trap 14 - BPT
-                                    return;
-                                case 4: // IOT  000004
-                                    trap(INTIOT);
-                                    return;
-                                case 5: // RESET 000005
-                                    RESET();
-                                    return;
-                                case 2: // RTI 000002
-                                    RTI();
-                                    return;
-                                case 6: // RTT 000006
-                                    RTT();
-                                    return;
-                                case 7: // MFPT
-                                    trap(INTINVAL);
-                                    return;
-                                default: // We don't know this 0000xx instruction
-                                    trap(INTINVAL);
-                                    return;
-                            }
-                        case 1: // JMP 0001DD
-                            JMP(instr);
-                            return;
-                        case 2:                         // 00002xR single register group
-                            switch ((instr >> 3) & 7) { // 00002xR register or CC
-                                case 0:                     // RTS 00020R
-                                    RTS(instr);
-                                    return;
-                                case 3: // SPL 00023N
-                                    if (currentmode()) {
-                                        return ;
-                                    }
-                                    PSW = ((PSW & 0177037) | ((instr & 7) << 5));
-                                    wasSPL = true ;
-                                    return;
-                                case 4: // CLR CC 00024C Part 1 without N
-                                case 5: // CLR CC 00025C Part 2 with N
-                                    PSW = (PSW & ~(instr & 017));
-                                    return;
-                                case 6: // SET CC 00026C Part 1 without N
-                                case 7: // SET CC 00027C Part 2 with N
-                                    PSW = (PSW | (instr & 017));
-                                    return;
-                                default: // We don't know this 00002xR instruction
-                                    trap(INTINVAL);
-                                    return;
-                            }
-                        case 3: // SWAB 0003DD
-                            SWAB(instr);
-                            return;
-                        default:
-                            trap(INTINVAL);
-                            return;
-                    }
-                case 1: // BR 0004 offset
-                    branch(instr);
-                    return;
-                case 2: // BNE 0010 offset
-                    if (!Z()) {
-                        branch(instr);
-                    }
-                    return;
-                case 3: // BEQ 0014 offset
-                    if (Z()) {
-                        branch(instr);
-                    }
-                    return;
-                case 4: // BGE 0020 offset
-                    if (!(N() xor V())) {
-                        branch(instr);
-                    }
-                    return;
-                case 5: // BLT 0024 offset
-                    if (N() xor V()) {
-                        branch(instr);
-                    }
-                    return;
-                case 6: // BGT 0030 offset
-                    if ((!(N() xor V())) && (!Z())) {
-                        branch(instr);
-                    }
-                    return;
-                case 7: // BLE 0034 offset
-                    if ((N() xor V()) || Z()) {
-                        branch(instr);
-                    }
-                    return;
-                case 8: // JSR 004RDD In two parts
-                case 9: // JSR 004RDD continued (9 bit instruction so use 2 x 8 bit
-                    JSR(instr);
-                    return;
-                default: // Remaining 0o00xxxx instructions where xxxx >= 05000
-                    switch (instr >> 6) { // 00xxDD
-                        case 050:             // CLR 0050DD
-                            CLR<2>(instr);
-                            return;
-                        case 051: // COM 0051DD
-                            COM<2>(instr);
-                            return;
-                        case 052: // INC 0052DD
-                            INC<2>(instr);
-                            return;
-                        case 053: // DEC 0053DD
-                            _DEC<2>(instr);
-                            return;
-                        case 054: // NEG 0054DD
-                            NEG<2>(instr);
-                            return;
-                        case 055: // ADC 0055DD
-                            _ADC<2>(instr);
-                            return;
-                        case 056: // SBC 0056DD
-                            SBC<2>(instr);
-                            return;
-                        case 057: // TST 0057DD
-                            TST<2>(instr);
-                            return;
-                        case 060: // ROR 0060DD
-                            ROR<2>(instr);
-                            return;
-                        case 061: // ROL 0061DD
-                            ROL<2>(instr);
-                            return;
-                        case 062: // ASR 0062DD
-                            ASR<2>(instr);
-                            return;
-                        case 063: // ASL 0063DD
-                            ASL<2>(instr);
-                            return;
-                        case 064: // MARK 0064nn
-                            MARK(instr);
-                            return;
-                        case 065: // MFPI 0065SS
-                            MFPI(instr);
-                            return;
-                        case 066: // MTPI 0066DD
-                            MTPI(instr);
-                            return;
-                        case 067: // SXT 0067DD
-                            SXT(instr);
-                            return;
-                        default: // We don't know this 0o00xxDD instruction
-                            trap(INTINVAL);
-                            return;
-                    }
-                }
-        case 1: // MOV  01SSDD
-            MOV<2>(instr);
-            return;
-        case 2: // CMP 02SSDD
-            CMP<2>(instr);
-            return;
-        case 3: // BIT 03SSDD
-            _BIT<2>(instr);
-            return;
-        case 4: // BIC 04SSDD
-            BIC<2>(instr);
-            return;
-        case 5: // BIS 05SSDD
-            BIS<2>(instr);
-            return;
-        case 6: // ADD 06SSDD
-            ADD(instr);
-            return;
-        case 7:                         // 07xRSS instructions
-            switch ((instr >> 9) & 7) { // 07xRSS
-                case 0:                     // MUL 070RSS
-                    MUL(instr);
-                    return;
-                case 1: // DIV 071RSS
-                    DIV(instr);
-                    return;
-                case 2: // ASH 072RSS
-                    ASH(instr);
-                    return;
-                case 3: // ASHC 073RSS
-                    ASHC(instr);
-                    return;
-                case 4: // XOR 074RSS
-                    XOR(instr);
-                    return;
-                case 7: // SOB 077Rnn
-                    SOB(instr);
-                    return;
-                default: // We don't know this 07xRSS instruction
-                    trap(INTINVAL);
-                    return;
-            }
-        case 8:                           // 10xxxx instructions
-            switch ((instr >> 8) & 0xf) { // 10xxxx 8 bit instructions first
-                case 0:                       // BPL 1000 offset
-                    if (!N()) {
-                        branch(instr);
-                    }
-                    return;
-                case 1: // BMI 1004 offset
-                    if (N()) {
-                        branch(instr);
-                    }
-                    return;
-                case 2: // BHI 1010 offset
-                    if ((!C()) && (!Z())) {
-                        branch(instr);
-                    }
-                    return;
-                case 3: // BLOS 1014 offset
-                    if (C() || Z()) {
-                        branch(instr);
-                    }
-                    return;
-                case 4: // BVC 1020 offset
-                    if (!V()) {
-                        branch(instr);
-                    }
-                    return;
-                case 5: // BVS 1024 offset
-                    if (V()) {
-                        branch(instr);
-                    }
-                    return;
-                case 6: // BCC 1030 offset
-                    if (!C()) {
-                        branch(instr);
-                    }
-                    return;
-                case 7: // BCS 1034 offset
-                    if (C()) {
-                        branch(instr);
-                    }
-                    return;
-                case 8:          // EMT 104xxx operand
-                    trap(INTEMT); // Trap 30 - EMT instruction
-                case 9:          // TRAP 1044 operand
-                    trap(INTTRAP); // Trap 34 - TRAP instruction
-                default: // Remaining 10xxxx instructions where xxxx >= 05000
-                    switch ((instr >> 6) & 077) { // 10xxDD group
-                        case 050:                     // CLRB 1050DD
-                            CLR<1>(instr);
-                            return;
-                        case 051: // COMB 1051DD
-                            COM<1>(instr);
-                            return;
-                        case 052: // INCB 1052DD
-                            INC<1>(instr);
-                            return;
-                        case 053: // DECB 1053DD
-                            _DEC<1>(instr);
-                            return;
-                        case 054: // NEGB 1054DD
-                            NEG<1>(instr);
-                            return;
-                        case 055: // ADCB 01055DD
-                            _ADC<1>(instr);
-                            return;
-                        case 056: // SBCB 01056DD
-                            SBC<1>(instr);
-                            return;
-                        case 057: // TSTB 1057DD
-                            TST<1>(instr);
-                            return;
-                        case 060: // RORB 1060DD
-                            ROR<1>(instr);
-                            return;
-                        case 061: // ROLB 1061DD
-                            ROL<1>(instr);
-                            return;
-                        case 062: // ASRB 1062DD
-                            ASR<1>(instr);
-                            return;
-                        case 063: // ASLB 1063DD
-                            ASL<1>(instr);
-                            return;
-                        case 065: // MFPD 1065DD
-                            MFPD(instr);
-                            return;
-                        case 066:
-                            MTPD(instr); // MTPD 1066DD
-                            return;
-                        // case 0o67: // MTFS 1064SS
-                        default: // We don't know this 0o10xxDD instruction
-                            trap(INTINVAL);
-                            return;
-                    }
-            }
-        case 9: // MOVB 11SSDD
-            MOV<1>(instr);
-            return;
-        case 10: // CMPB 12SSDD
-            CMP<1>(instr);
-            return;
-        case 11: // BITB 13SSDD
-            _BIT<1>(instr);
-            return;
-        case 12: // BICB 14SSDD
-            BIC<1>(instr);
-            return;
-        case 13: // BISB 15SSDD
-            BIS<1>(instr);
-            return;
-        case 14: // SUB 16SSDD
-            SUB(instr);
-            return;
-        case 15:
-            fp11(instr);
-            break;
-            [[fallthrough]];
-        default: // 15  17xxxx FPP instructions
-            trap(INTINVAL);
-            return ;
-    }
-}
 
-void KB11::calc_irqs() {
-    irq_vec = 0 ;
-    u8 pri = 0 ;
-    
-    for (int i = 0; i < 128; i++) {
-        if (!irqs[i]) {
-            continue ;
-        }
-
-        if (irqs[i] >= pri) {
-            irq_vec = i << 1;
-            pri = irqs[i] ;
-        }
-    }
+    ticks += optime[instr] ;
+    optable[instr](*this, instr) ;
 }
 
+/*
+ * The highest pending level comes from one CLZ on irqlevels. Within a level
+ * the highest vector wins, the same order the old scan over irqs[] gave.
+ */
 u8 KB11::interrupt_vector() {
-    if (irq_dirty) {
-        calc_irqs() ;
-        irq_dirty = false ;
+    if (!irqlevels) {
+        return 0 ;
     }
 
-    if (!irq_vec) {
+    const u8 l = 31 - __builtin_clz(irqlevels) ;
+    if (l <= cpuPriority) {
         return 0 ;
     }
 
-    u8 v = irq_vec >> 1;
-
-    if (irqs[v] > cpuPriority) {
-        irqs[v] = 0 ;
-        irq_vec = 0 ;
-        irq_dirty = true ;
-        return v << 1;
+    for (int w = 3; w >= 0; w--) {
+        if (irqmap[l][w]) {
+            const u8 v = (w << 5) | (31 - __builtin_clz(irqmap[l][w])) ;
+            irqdrop(v) ;
+            return v << 1 ;
+        }
     }
 
     return 0 ;
@@ -999,8 +896,20 @@ void KB11::interrupt(const u8 vec, const u8 pri) {
         while(!interrupted);
     }
 
-    irqs[vec >> 1] = pri ;
-    irq_dirty = true ;
+    const u8 v = vec >> 1 ;
+    if (irqs[v] == pri) {
+        return ;
+    }
+
+    if (irqs[v]) {
+        irqdrop(v) ;
+    }
+
+    if (pri) {
+        irqs[v] = pri ;
+        irqmap[pri][v >> 5] |= 1u << (v & 31) ;
+        irqlevels |= 1 << pri ;
+    }
 }
 
 void KB11::trapat(u8 vec) {
@@ -1009,6 +918,9 @@ void KB11::trapat(u8 vec) {
         while(!interrupted) ;
     }
 
+    ticks += KB11_TRAP_TICKS ;
+
+    flags() ;
     u16 PC = RR[7] ;
     u16 opsw = PSW;
     
@@ -1040,6 +952,7 @@ static const char *modnames[4] = {
 } ;
 
 void KB11::ptstate() {
+    flags() ;
     Console::get()->printf("    R%d %06o R%d %06o R%d %06o R%d %06o\r\n", REGNAME(0), RR[REG(0)], REGNAME(1), RR[REG(1)], REGNAME(2), RR[REG(2)], REGNAME(3), RR[REG(3)]);
     Console::get()->printf("    R%d %06o R%d %06o R6 %06o PS %06o\r\n", REGNAME(4), RR[REG(4)], REGNAME(5), RR[REG(5)], RR[6], PSW);
     
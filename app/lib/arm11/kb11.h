@@ -5,6 +5,8 @@
 
 #include "kt11.h"
 #include "unibus.h"
+#include "event.h"
+#include "ioengine.h"
 #include "xx11.h"
 
 //#define NOI2C 1
@@ -24,6 +26,10 @@
 #define STACK_LIMIT_YELLOW 0400
 #define STACK_LIMIT_RED    0340
 
+// instruction timing is kept in 50 ns ticks, see buildOpTable()
+#define KB11_TICKS_PER_US   20
+#define KB11_TRAP_TICKS     42 // trap and interrupt service, 2.1 us
+
 enum CPUStatus : u8 {
     CPU_STATUS_UNKNOWN,
     CPU_STATUS_ENABLE,
@@ -42,6 +48,18 @@ enum StackTrap : u8 {
     STACK_TRAP_RED
 } ;
 
+// How pending condition codes are derived from ccres/cca/ccb, see KB11::lazyCC
+enum LazyCC : u8 {
+    CC_NONE,    // PSW holds the condition codes
+    CC_NZ,      // N, Z from result, V cleared, C unchanged
+    CC_INC,     // as CC_NZ, V if result is 0100000
+    CC_DEC,     // as CC_NZ, V if result is 077777
+    CC_TST,     // N, Z from result, V and C cleared
+    CC_ADD,     // result = a + b
+    CC_SUB,     // result = a - b
+    CC_BYTE = 0200
+} ;
+
 class API ;
 class ODT ;
 
@@ -50,6 +68,9 @@ class KB11 : public XX11 {
     friend ODT ;
     friend UNIBUS ;
   public:
+    // KB11Op executes one already fetched instruction.
+    typedef void (*KB11Op)(KB11 &cpu, const u16 instr) ;
+
     KB11() ;
 
     void step();
@@ -57,6 +78,14 @@ class KB11 : public XX11 {
     void pirq() ;
     void trapat(u8 vec);
 
+    // flags folds pending condition codes into PSW. Anything outside the
+    // instruction handlers that looks at the PSW condition bits calls it first.
+    inline void flags() {
+        if (ccop != CC_NONE) {
+            evalflags() ;
+        }
+    }
+
     // interrupt schedules an interrupt.
     void interrupt(const u8 vec, const u8 pri);
     void printstate();
@@ -71,11 +100,7 @@ class KB11 : public XX11 {
     constexpr inline u16 previousmode() { return ((PSW >> 12) & 3); }
 
     void inline updatePriority() {
-        u8 v = cpuPriority ;
         cpuPriority = (PSW >> 5) & 7 ;
-        if (v != cpuPriority) {
-            irq_dirty = true ;
-        }
     }
 
     constexpr inline bool denabled() {
@@ -101,10 +126,14 @@ class KB11 : public XX11 {
     
     KT11 mmu;
     UNIBUS unibus;
+    EventQueue events;
+    IOEngine io;
     bool print=false;
     bool wtstate;
     bool wasRTT = false, wasSPL = false ;
     StackTrap stackTrap = STACK_TRAP_NONE ;
+    u8 trapreq = 0 ; // trap latched by EMT/TRAP/IOT/BPT, taken by loop() after step()
+    u64 ticks = 0 ;  // emulated 11/70 time in 50 ns ticks, paces the throttle
 
     u16 readW(const u16 va, bool d = false, bool src = true) ;
     virtual u16 read16(const u32 a) ;
@@ -121,8 +150,7 @@ class KB11 : public XX11 {
 
     inline void clearIRQ(const u8 vec) {
         if (irqs[vec >> 1]) {
-            irqs[vec >> 1] = 0 ;
-            irq_dirty = true ;
+            irqdrop(vec >> 1) ;
         }
     }
 
@@ -145,17 +173,64 @@ class KB11 : public XX11 {
     u16 stackpointer[4]; // Alternate R6 (kernel, super, illegal, user)
     u16 pirqr = 0 ;
     u32 ldat = 0, lda = 0 ;
+    u16 fetchlo = 1, fetchhi = 0, fetchmode = 0 ; // empty until the first fetch
+    u32 fetchoff = 0, fetchgen = 0 ;
+
+    u8 ccop = CC_NONE ;
+    u16 ccres = 0, cca = 0, ccb = 0 ;
+    void evalflags() ;
 
     u8 cpuPriority = 0 ;
-    u8 irqs[128] ;
-    u8 irq_vec = 0;
-    bool irq_dirty = false ;
-    void calc_irqs() ;
-    
-    inline bool N() { return PSW & PSW_BIT_N; }
-    inline bool Z() { return PSW & PSW_BIT_Z; }
-    inline bool V() { return PSW & PSW_BIT_V; }
-    inline bool C() { return PSW & PSW_BIT_C; }
+    u8 irqs[128] ;         // pending level per vector/2, 0 when none
+    u32 irqmap[8][4] ;     // pending vectors per level, bit n of word w is vector (w * 32 + n) * 2
+    u8 irqlevels = 0 ;     // bit l set while irqmap[l] is not empty
+
+    inline void irqdrop(const u8 v) {
+        const u8 l = irqs[v] ;
+        irqmap[l][v >> 5] &= ~(1u << (v & 31)) ;
+        if (!(irqmap[l][0] | irqmap[l][1] | irqmap[l][2] | irqmap[l][3])) {
+            irqlevels &= ~(1 << l) ;
+        }
+        irqs[v] = 0 ;
+    }
+
+    // optable maps every instruction word to its handler, built once by buildOpTable()
+    static KB11Op optable[65536] ;
+    static u8 optime[65536] ;  // execution time in ticks, cache hit, addressing modes included
+    static void buildOpTable() ;
+
+    // op handlers see the condition codes in PSW, lz handlers only set them through lazyCC
+    template <void (KB11::*fn)(const u16)> static void op(KB11 &cpu, const u16 instr) {
+        cpu.flags() ;
+        (cpu.*fn)(instr) ;
+    }
+
+    template <void (KB11::*fn)()> static void op(KB11 &cpu, const u16 instr) {
+        cpu.flags() ;
+        (cpu.*fn)() ;
+    }
+
+    template <void (KB11::*fn)(const u16)> static void lz(KB11 &cpu, const u16 instr) {
+        (cpu.*fn)(instr) ;
+    }
+
+    // lazyCC records the operation instead of computing N/Z/V/C. Ops that keep
+    // C need the previous C in PSW, so a pending op that produces C is folded first.
+    template <auto len> inline void lazyCC(const u8 op, const u16 res, const u16 a = 0, const u16 b = 0) {
+        static_assert(len == 1 || len == 2);
+        if (op < CC_TST && (ccop & ~CC_BYTE) >= CC_TST) {
+            evalflags() ;
+        }
+        ccop = len == 1 ? op | CC_BYTE : op ;
+        ccres = res ;
+        cca = a ;
+        ccb = b ;
+    }
+
+    inline bool N() { flags() ; return PSW & PSW_BIT_N; }
+    inline bool Z() { flags() ; return PSW & PSW_BIT_Z; }
+    inline bool V() { flags() ; return PSW & PSW_BIT_V; }
+    inline bool C() { flags() ; return PSW & PSW_BIT_C; }
     inline void setZ(const bool b) {
         if (b)
             PSW |= PSW_BIT_Z;
@@ -165,8 +240,27 @@ class KB11 : public XX11 {
         PSW = (PSW & ~bit) | (b ? bit : 0) ;
     }
     
+    // fetch16 reads straight from core while the PC stays inside the window
+    // fetchwindow() gave for the current mode and MMU generation.
     inline u16 fetch16() {
-        const auto val = readW(RR[7]);
+        const u16 va = RR[7] ;
+        if (!(va & 1) && va >= fetchlo && va <= fetchhi && fetchmode == currentmode() && fetchgen == mmu.tlbgen) {
+            const u32 a = va + fetchoff ;
+            ldat = a ;
+            mmu.lastWasData = false ;
+            RR[7] += 2;
+            return unibus.core[a >> 1] ;
+        }
+
+        const auto val = readW(va);
+        if (!(va & 1) && mmu.fetchwindow(va, currentmode(), fetchlo, fetchhi, fetchoff)) {
+            if (fetchhi + fetchoff >= MEMSIZE) {
+                fetchlo = 1 ;
+                fetchhi = 0 ;
+            }
+            fetchmode = currentmode() ;
+            fetchgen = mmu.tlbgen ;
+        }
         RR[7] += 2;
         return val;
     }
@@ -332,6 +426,109 @@ class KB11 : public XX11 {
         }
     }
 
+    // BR 0004 offset
+    inline void BR(const u16 instr) {
+        branch(instr) ;
+    }
+
+    // BNE 0010 offset
+    inline void BNE(const u16 instr) {
+        if (!Z()) {
+            branch(instr) ;
+        }
+    }
+
+    // BEQ 0014 offset
+    inline void BEQ(const u16 instr) {
+        if (Z()) {
+            branch(instr) ;
+        }
+    }
+
+    // BGE 0020 offset
+    inline void BGE(const u16 instr) {
+        if (!(N() xor V())) {
+            branch(instr) ;
+        }
+    }
+
+    // BLT 0024 offset
+    inline void BLT(const u16 instr) {
+        if (N() xor V()) {
+            branch(instr) ;
+        }
+    }
+
+    // BGT 0030 offset
+    inline void BGT(const u16 instr) {
+        if ((!(N() xor V())) && (!Z())) {
+            branch(instr) ;
+        }
+    }
+
+    // BLE 0034 offset
+    inline void BLE(const u16 instr) {
+        if ((N() xor V()) || Z()) {
+            branch(instr) ;
+        }
+    }
+
+    // BPL 1000 offset
+    inline void BPL(const u16 instr) {
+        if (!N()) {
+            branch(instr) ;
+        }
+    }
+
+    // BMI 1004 offset
+    inline void BMI(const u16 instr) {
+        if (N()) {
+            branch(instr) ;
+        }
+    }
+
+    // BHI 1010 offset
+    inline void BHI(const u16 instr) {
+        if ((!C()) && (!Z())) {
+            branch(instr) ;
+        }
+    }
+
+    // BLOS 1014 offset
+    inline void BLOS(const u16 instr) {
+        if (C() || Z()) {
+            branch(instr) ;
+        }
+    }
+
+    // BVC 1020 offset
+    inline void BVC(const u16 instr) {
+        if (!V()) {
+            branch(instr) ;
+        }
+    }
+
+    // BVS 1024 offset
+    inline void BVS(const u16 instr) {
+        if (V()) {
+            branch(instr) ;
+        }
+    }
+
+    // BCC 1030 offset
+    inline void BCC(const u16 instr) {
+        if (!C()) {
+            branch(instr) ;
+        }
+    }
+
+    // BCS 1034 offset
+    inline void BCS(const u16 instr) {
+        if (C()) {
+            branch(instr) ;
+        }
+    }
+
     /**
      * Programs operating at outer levels (Supervisor and User)
      *   are inhibited from changing bits 5-7 (the Processor's Priority).
@@ -360,13 +557,15 @@ class KB11 : public XX11 {
         // }
 
         PSW = newpsw ;
+        ccop = CC_NONE ;
         cpuPriority = (PSW >> 5) & 7 ;
 
         RR[6] = stackpointer[currentmode()];
     }
 
     // kernelmode pushes the current processor mode and switchs to kernel.
-    constexpr inline void kernelmode() {
+    inline void kernelmode() {
+        flags() ;
         writePSW((PSW & 0007777) | (currentmode() << 12));
     }
 
@@ -444,39 +643,17 @@ class KB11 : public XX11 {
 
         const auto dst = read<l>(op.operand, dpage, false);
         const auto sval = (src - dst) & max<l>();
-        PSW &= PSW_MASK_COND;
-        if (sval == 0) {
-            PSW |= PSW_BIT_Z;
-        }
-        if (sval & msb<l>()) {
-            PSW |= PSW_BIT_N;
-        }
-        if (((src ^ dst) & msb<l>()) && (!((dst ^ sval) & msb<l>()))) {
-            PSW |= PSW_BIT_V;
-        }
-        if (src < dst) {
-            PSW |= PSW_BIT_C;
-        }
+        lazyCC<l>(CC_SUB, sval, src, dst) ;
     }
 
     // Set N & Z clearing V (C unchanged)
     template <auto len> inline void setNZ(const u16 v) {
-        static_assert(len == 1 || len == 2);
-        PSW &= (PSW_MASK_COND | PSW_BIT_C);
-        if (v & msb<len>()) {
-            PSW |= PSW_BIT_N;
-        }
-        if ((v & max<len>()) == 0) {
-            PSW |= PSW_BIT_Z;
-        }
+        lazyCC<len>(CC_NZ, v) ;
     }
 
     // Set N, Z & V (C unchanged)
     template <auto len> inline void setNZV(const u16 v) {
-        setNZ<len>(v);
-        if (v == msb<len>()) {
-            PSW |= PSW_BIT_V;
-        }
+        lazyCC<len>(CC_INC, v) ;
     }
 
     // Set N, Z & C clearing V
@@ -501,11 +678,7 @@ class KB11 : public XX11 {
         const bool dpage = denabled() && op.operandType == OPERAND_DATA ;
         const auto dst = read<l>(op.operand, dpage, false);
         auto uval = (max<l>() ^ src) & dst;
-        PSW &= (PSW_MASK_COND | PSW_BIT_C);
-        setZ(uval == 0);
-        if (uval & msb<l>()) {
-            PSW |= PSW_BIT_N;
-        }
+        setNZ<l>(uval);
         write<l>(op.operand, uval, dpage);
     }
 
@@ -518,19 +691,14 @@ class KB11 : public XX11 {
         const bool dpage = denabled() && op.operandType == OPERAND_DATA ;
         const auto dst = read<l>(op.operand, dpage, false);
         auto uval = src | dst;
-        PSW &= (PSW_MASK_COND | PSW_BIT_C);
-        setZ(uval == 0);
-        if (uval & msb<l>()) {
-            PSW |= PSW_BIT_N;
-        }
+        setNZ<l>(uval);
         write<l>(op.operand, uval, dpage);
         datapath = uval ;
 }
 
     // CLR 0050DD, CLRB 1050DD
     template <auto l> void CLR(const u16 instr) {
-        PSW &= PSW_MASK_COND;
-        PSW |= PSW_BIT_Z;
+        lazyCC<l>(CC_TST, 0) ;
         Operand op = DA<l>(instr) ;
         if (stackTrap == STACK_TRAP_RED) {
             return ;
@@ -567,12 +735,8 @@ class KB11 : public XX11 {
             return ;
         }
         const bool dpage = denabled() && op.operandType == OPERAND_DATA ;
-        const auto oval = read<l>(op.operand, dpage, false) & max<l>();
         const auto uval = (read<l>(op.operand, dpage, false) - 1) & max<l>();
-        setNZ<l>(uval);
-        if (oval == msb<l>()) {
-            PSW |= PSW_BIT_V;
-        }
+        lazyCC<l>(CC_DEC, uval) ;
         write<l>(op.operand, uval, dpage);
         datapath = uval ;
 }
@@ -787,13 +951,7 @@ class KB11 : public XX11 {
         Operand op = DA<l>(instr, false) ;
         const bool dpage = denabled() && op.operandType == OPERAND_DATA ;
         const auto dst = read<l>(op.operand, dpage, false);
-        PSW &= PSW_MASK_COND;
-        if ((dst & max<l>()) == 0) {
-            PSW |= PSW_BIT_Z;
-        }
-        if (dst & msb<l>()) {
-            PSW |= PSW_BIT_N;
-        }
+        lazyCC<l>(CC_TST, dst) ;
     }
 
     // MOV 01SSDD, MOVB 11SSDD
@@ -839,4 +997,14 @@ class KB11 : public XX11 {
     void RTT();
     void RESET();
     void WAIT();
+    void HALT();
+    void SPL(const u16 instr);
+    void CCC(const u16 instr);
+    void SCC(const u16 instr);
+    void BPT();
+    void IOT();
+    void EMT();
+    void TRAP();
+    void FPP(const u16 instr);
+    void INVAL();
 };
\ No newline at end of file
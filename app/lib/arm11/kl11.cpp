@@ -3,6 +3,8 @@
 #include "kb11.h"
 #include <circle/logger.h>
 #include <circle/serial.h>
+#include <cons/cons.h>
+#include <cons/vtscreen.h>
 
 #ifndef ARM_ALLOW_MULTI_CORE
 #define ARM_ALLOW_MULTI_CORE
@@ -15,21 +17,38 @@ extern KB11 cpu;
 extern volatile bool interrupted ;
 extern CSerialDevice *pSerial ;
 
-static char kl11_char = '\0' ;
+u32 KL11::baud = KL11_BAUD ;
+bool KL11::serial = true ;
 
-static int _kbhit() {
-	char c ;
-	int n = pSerial->Read(&c, 1) ;
-	if (n <= 0) {
-		return false ;
-	}
+// chartime is how long a character takes on the line, ten bits of it
+static inline u64 chartime() {
+	return 10000000ull / KL11::baud ;
+}
+
+KL11::KL11()
+:	pastereq(false),
+	xoff(false),
+	throttled(false),
+	lastcr(false)
+{
+}
 
-	kl11_char = c ;
+void KL11::attach() {
+	if (serial) {
+		pSerial->RegisterCharReceivedHandler(received, this) ;
+	} else {
+		Console::get()->redirect(send) ;
+	}
+}
 
-	return true ;
+// received runs in the serial interrupt handler, what does not fit the ring is lost
+void KL11::received(u8 c, int status, void *param) {
+	((KL11 *) param)->rx.put(c) ;
 }
 
-KL11::KL11() {
+// send puts the ODT output on the transmit ring, Console calls it only on the emulator core where xpoll runs
+bool KL11::send(const char c) {
+	return cpu.unibus.cons.tx.put(c) ;
 }
 
 void KL11::clearterminal() {
@@ -37,6 +56,8 @@ void KL11::clearterminal() {
 	xcsr = 0200 ; // transmitter ready
 	rbuf = 0;
 	xbuf = 0;
+	rdue = xdue = 0 ;
+	xoff = false ;
 }
 
 u16 KL11::read16(const u32 a) {
@@ -45,6 +66,9 @@ u16 KL11::read16(const u32 a) {
 			return rcsr;
 		case KL11_RBUF:
 			rcsr &= ~0200 ;
+			if (rbusy()) {
+				cpu.events.schedule(EV_KLR, 1) ; // the next character is waiting
+			}
 			return rbuf;
 		case KL11_XCSR:
 			return xcsr;
@@ -78,6 +102,10 @@ void KL11::write16(const u32 a, const u16 v) {
 		case KL11_XBUF:
 			xbuf = (v & 0177) | 0400 ;
 			xcsr &= ~0200 ;
+			if (baud) {
+				xdue = CTimer::GetClockTicks64() + chartime() ;
+			}
+			cpu.events.schedule(EV_KL, 1) ;
 			break ;
 
 		default:
@@ -88,63 +116,121 @@ void KL11::write16(const u32 a, const u16 v) {
 }
 
 void KL11::rpoll() {
-	if (rcsr & 0200) {
+	// the serial ring is emptied whatever the guest does, as far as the feed has room
+	u8 c ;
+	while (feed.room() && rx.get(c)) {
+		if (c & 0200) {
+			control(c) ;
+		} else {
+			feed.put(c) ;
+		}
+	}
+
+	// near the cap the terminal is asked to stop sending, and to go on once the guest has caught up
+	if (!throttled && feed.room() < KL11_RING && tx.put(023)) {
+		throttled = true ;
+	} else if (throttled && feed.count() < FEED_MAX / 2 && tx.put(021)) {
+		throttled = false ;
+	}
+
+	if (feed.count() < KL11_LOW) {
+		refill() ;
+	}
+
+	if ((rcsr & 0200) || xoff || feed.empty()) {
 		return ;
 	}
 
-	if (_kbhit()) {
-		rbuf = kl11_char & 0377 ;
-		if (rbuf & 0200) {
-			switch (rbuf) {
-				case 0201:
-					CMultiCoreSupport::SendIPI(0, IPI_USER) ;
-					return ;
-				case 0202:
-					CMultiCoreSupport::SendIPI(0, IPI_USER + 1) ;
-					return ;
-				case 0203:
-					CMultiCoreSupport::SendIPI(0, IPI_USER + 2) ;
-					return ;
-				default:
-				    CLogger::Get()->Write("KL11", LogError, "unknown control character %03o", rbuf) ;
-					return ;
-				}
-		}
-		rcsr |= 0200;
-		if (rcsr & 0100) {
-			cpu.interrupt(INTTTYIN, 4);
-		} else {
-			cpu.clearIRQ(INTTTYIN) ;
+	if (baud) {
+		u64 t = CTimer::GetClockTicks64() ;
+		if (t < rdue) {
+			return ;
 		}
+		rdue = t + chartime() ;
 	}
 
+	feed.get(c) ;
+	rbuf = c ;
+	rcsr |= 0200;
+	if (rcsr & 0100) {
+		cpu.interrupt(INTTTYIN, 4);
+	} else {
+		cpu.clearIRQ(INTTTYIN) ;
+	}
 }
 
-static u64 lx = 0 ; 
+// control acts on the host commands, characters with bit 7 set
+void KL11::control(const u8 c) {
+	switch (c) {
+		case 0201:
+			CMultiCoreSupport::SendIPI(0, IPI_USER) ;
+			break ;
+		case 0202:
+			CMultiCoreSupport::SendIPI(0, IPI_USER + 1) ;
+			break ;
+		case 0203:
+			CMultiCoreSupport::SendIPI(0, IPI_USER + 2) ;
+			break ;
+		case 0204:
+			__atomic_store_n(&pastereq, true, __ATOMIC_RELEASE) ; // the paste file task opens PASTE.TXT
+			break ;
+		default:
+			CLogger::Get()->Write("KL11", LogError, "unknown control character %03o", c) ;
+			break ;
+	}
+}
 
-// #define KL11_DEBUG
+// inject puts pasted text on the feed, a line ends in CR as the terminal would send it
+void KL11::inject(const u8 c) {
+	if (c == '\n') {
+		if (!lastcr) {
+			feed.put('\r') ;
+		}
+	} else {
+		feed.put(c & 0177) ;
+	}
+	lastcr = c == '\r' ;
+}
 
-void KL11::xpoll() {
-	if (xcsr & 0200) {
-		return ;
+// refill takes what the paste file task and the paste socket have brought, both are read on core 0
+void KL11::refill() {
+	u8 c ;
+	while (feed.count() < KL11_LOW && filein.get(c)) {
+		inject(c) ;
+	}
+	while (feed.count() < KL11_LOW && netin.get(c)) {
+		inject(c) ;
 	}
+}
 
-	// rate output limit to about 28800 bit/s
-	u64 t = CTimer::GetClockTicks64() ;
+// drain hands the transmit ring to the serial driver, as much as its buffer takes
+void KL11::drain() {
+	if (!serial) {
+		return ; // the USB console task takes it
+	}
 
-	if (lx == 0) {
-		lx = t ;
-	} else {
-		if (t - lx < 315lu) {
-			if (!(xcsr & 0100)) {
-				cpu.clearIRQ(INTTTYOUT) ;
-			}
+	const u8 *p ;
+	u32 n ;
+	while ((n = tx.peek(p)) > 0) {
+		int w = pSerial->Write(p, n) ;
+		if (w <= 0) {
+			return ;
+		}
+		tx.drop(w) ;
+		if ((u32) w < n) {
 			return ;
 		}
-
-		lx = t ;
 	}
+}
+
+// #define KL11_DEBUG
 
+void KL11::xpoll() {
+	drain() ;
+
+	if (xcsr & 0200) {
+		return ;
+	}
 
 #ifdef KL11_DEBUG
 	static FIL ft ;
@@ -162,9 +248,19 @@ void KL11::xpoll() {
 
 	if (xbuf) {
 		u8 c = xbuf & 0377 ;
-		if (pSerial->Write(&c, 1) != 1) {
-			// CLogger::Get()->Write("KL11", LogError, "xpoll send error") ;
-			return ;
+		VTScreen *vt = VTScreen::get() ;
+		if (!tx.room() || (vt && !vt->room())) {
+			return ; // a ring is full, READY waits for the serial port or the screen
+		}
+		tx.put(c) ;
+		if (vt) {
+			vt->put(c) ;
+		}
+		if (c == 023) {
+			xoff = true ;
+		} else if (c == 021) {
+			xoff = false ;
+			cpu.events.schedule(EV_KLR, 1) ;
 		}
 
 #ifdef KL11_DEBUG
@@ -174,6 +270,11 @@ void KL11::xpoll() {
 #endif
 
 		xbuf = 0 ;
+		drain() ;
+	}
+
+	if (baud && CTimer::GetClockTicks64() < xdue) {
+		return ;
 	}
 
 	xcsr |= 0200 ;
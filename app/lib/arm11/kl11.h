@@ -1,6 +1,9 @@
 #pragma once
 
 #include <circle/types.h>
+#include <fatfs/ff.h>
+#include "feed.h"
+#include "ring.h"
 #include "xx11.h"
 
 #define KL11_XCSR 017777564
@@ -8,6 +11,29 @@
 #define KL11_RCSR 017777560
 #define KL11_RBUF 017777562
 
+#define KL11_RING 2048  // bytes each way between the emulator and the serial port
+#define KL11_BAUD 28800 // line speed when BAUD= is not set
+#define KL11_LOW 512    // the paste file and socket are read again when the feed holds less
+
+#define KL11_PASTE "SD:/PIP-11/PASTE.TXT"
+
+/*
+ * Console terminal. The serial interrupt handler puts what comes in on the
+ * receive ring, the emulator takes one character into RBUF each time the
+ * guest has read the last. XBUF goes onto the transmit ring, which is handed
+ * to the serial driver in batches. DONE and READY come back after one
+ * character time of the emulated line, or at once when it is unlimited.
+ *
+ * Input waits in a feed, the serial ring is emptied into it whether the
+ * guest reads or not. Near FEED_MAX the terminal gets an XOFF and the ring is
+ * left to fill, an XON follows once the feed is half empty. PASTE.TXT and the
+ * paste socket are read on core 0 into rings of their own, which go into the
+ * feed as it runs low. An XOFF from the guest holds the feed until XON.
+ *
+ * With the terminal on USB the serial port is left alone, a task on core 0
+ * moves both rings and the ODT writes through the transmit ring as well.
+ * The screen terminal, when there is one, gets a copy of the output.
+ */
 class KL11 : public XX11 {
 
   public:
@@ -16,12 +42,48 @@ class KL11 : public XX11 {
     void clearterminal();
     void xpoll() ;
     void rpoll() ;
+    void drain() ;
+    inline bool xbusy() { return !(xcsr & 0200) || !tx.empty() ; }
+    inline bool rbusy() { return !feed.empty() ; }
     u16 read16(const u32 a);
     void write16(const u32 a, const u16 v);
+
+    // attach takes the serial input over, hostget hands it to the ODT while the CPU is halted
+    void attach() ;
+    inline bool hostget(u8 &c) { return rx.get(c) ; }
+
+    // the USB console task moves the rings in place of the serial driver
+    inline bool hostput(const u8 c) { return rx.put(c) ; }
+    inline u32 hostroom() { return rx.room() ; }
+    inline u32 hostpeek(const u8 *&p) { return tx.peek(p) ; }
+    inline void hostdrop(const u32 n) { tx.drop(n) ; }
+
+    // pastereq asks the paste file task to feed PASTE.TXT from the start, from any core
+    bool pastereq ;
+    ByteRing<KL11_RING> filein ; // from the paste file task on core 0
+    ByteRing<KL11_RING> netin ;  // from the paste socket on core 0
+
+    static u32 baud ;    // emulated line speed, BAUD= in CONFIG.INI, 0 is unlimited
+    static bool serial ; // the terminal is on the serial port, CONSOLE=USB clears it
 	
   private:
     u16 rcsr;
     u16 rbuf;
     u16 xcsr;
     u16 xbuf;
+    u64 rdue, xdue ; // host time the receiver and the transmitter are through with a character
+
+    ByteRing<KL11_RING> rx, tx ;
+
+    TextFeed feed ;
+    bool xoff ;   // the guest asked the terminal to stop sending
+    bool throttled ; // the feed is near full, the terminal was sent an XOFF
+    bool lastcr ; // the last pasted character was a CR
+
+    void control(const u8 c) ;
+    void inject(const u8 c) ;
+    void refill() ;
+
+    static void received(u8 c, int status, void *param) ;
+    static bool send(const char c) ;
 } ;
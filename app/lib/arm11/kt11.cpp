@@ -8,6 +8,7 @@ KT11::KT11() {
     for (int i = 0; i < 64; i++) {
         UBMR[i] = 0 ;
     }
+    tlbflush() ;
 }
 
 void KT11::reset() {
@@ -16,6 +17,17 @@ void KT11::reset() {
     }
     SR[0]=0;
     SR[3]=0;
+    tlbflush() ;
+}
+
+void KT11::tlbflush() {
+    tlbgen++ ;
+    for (int m = 0; m < 4; m++) {
+        for (int i = 0; i < 16; i++) {
+            tlb[m][i][0].valid = false ;
+            tlb[m][i][1].valid = false ;
+        }
+    }
 }
 
 bool KT11::is_internal(const u32 a) {
@@ -119,6 +131,7 @@ void KT11::write16(const u32 a, const u16 v) {
     switch (a) {
         case 017777572:
             SR[0] = v ;
+            tlbflush() ;
             return ;
         case 017777574:
             // SR[1] = v; // read-only
@@ -128,11 +141,13 @@ void KT11::write16(const u32 a, const u16 v) {
             return;
         case 017772516:
             cpu.mmu.SR[3] = v & 067 ;
+            tlbflush() ;
             return ;
     }
 
     const u8 i = ((a & 017) >> 1);
     const u8 d = i + 8 ;
+    tlbflush() ;
     switch (a & ~017) {
         case 017772200:
             pages[01][i].pdr = v & 077417;
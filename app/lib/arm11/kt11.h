@@ -86,6 +86,8 @@ class KT11 : public XX11 {
 
             if (aa > 0757777) {
                 aa += 017000000 ;
+            } else if (!(SR[0] & 01000)) {
+                tlbfill<wr>(mode, i, pages[mode][i].addr() << 6, 0757777) ;
             }
 
             return aa ;
@@ -154,6 +156,10 @@ class KT11 : public XX11 {
                 infotrap = true ;
             }
 
+            if (aa <= 016777777U && !(SR[0] & 01000)) {
+                tlbfill<wr>(mode, apf, pages[mode][apf].addr22() << 6, 016777777U) ;
+            }
+
             // The 124K of addresses from 17 000 000 - 17 757 777 may be used to access memory via the Unibus Map
             if (aa > 016777777U && aa < 017760000U) {
                 // u32 a22 = aa ;
@@ -180,6 +186,15 @@ class KT11 : public XX11 {
                 return decode16(a) ;
             }
 
+            // MMU ON, no maintenance: try the cached translation first
+            if ((SR[0] & 01401) == 1) {
+                const tlbent &t = tlb[mode][(a >> 13) + (d ? 8 : 0)][wr] ;
+                const u8 block = (a >> 6) & 0177 ;
+                if (t.valid && block >= t.lo && block <= t.hi) {
+                    return t.base + (a & 017777) ;
+                }
+            }
+
             // MMU ON, 18bit mode
             if ((SR[3] & 020) == 0) {
                 return decode18<wr>(a, mode, d, src) ;
@@ -231,7 +246,62 @@ class KT11 : public XX11 {
 
         page pages[4][16] ;
 
+        void tlbflush() ;
+        u32 tlbgen = 0 ; // bumped on every flush
+
+        // fetchwindow reports the virtual range around a that maps straight to
+        // memory as pa = va + off with the current registers, for KB11::fetch16.
+        inline bool fetchwindow(const u16 a, const u16 mode, u16 &lo, u16 &hi, u32 &off) {
+            if ((SR[0] & 0401) == 0) {
+                if (a > 0157777) {
+                    return false ;
+                }
+                lo = 0 ;
+                hi = 0157776 ;
+                off = 0 ;
+                return true ;
+            }
+
+            if ((SR[0] & 01401) != 1) {
+                return false ;
+            }
+
+            const u8 apf = a >> 13 ;
+            const tlbent &t = tlb[mode][apf][0] ;
+            if (!t.valid) {
+                return false ;
+            }
+
+            lo = (apf << 13) | (t.lo << 6) ;
+            hi = (apf << 13) | (t.hi << 6) | 076 ;
+            off = t.base - (apf << 13) ;
+            return true ;
+        }
+
     private:
+        // tlb holds translations that already passed every check in
+        // decode18/decode22, indexed by [mode][page][wr]. Pages that reach
+        // the I/O page, the Unibus map window or wrap around are not cached.
+        struct tlbent {
+            u32 base ;  // physical address of the page start
+            u8 lo, hi ; // accessible block range
+            bool valid ;
+        } ;
+
+        tlbent tlb[4][16][2] ;
+
+        template <bool wr> inline void tlbfill(const u16 mode, const u8 apf, const u32 base, const u32 limit) {
+            if (base + 017777 > limit) {
+                return ;
+            }
+
+            tlbent &t = tlb[mode][apf][wr] ;
+            t.base = base ;
+            t.lo = pages[mode][apf].ed() ? pages[mode][apf].len() : 0 ;
+            t.hi = pages[mode][apf].ed() ? 0177 : pages[mode][apf].len() ;
+            t.valid = true ;
+        }
+
         bool is_internal(const u32 a) ;
         bool is_debug() ;
         u16 UBMR[64] ;
@@ -13,7 +13,6 @@ const u8 LP11_I2C_LPS = 014 ;
 const u8 LP11_I2C_LPB = 016 ;
 
 extern CI2CMaster *pI2cMaster ;
-int lp11_delay = 0 ;
 
 static u16 lp11_i2c_read(const u8 addr) {
     u8 result[3] = {0, 0, 0} ;
@@ -78,11 +77,11 @@ void LP11::write16(const u32 a, const u16 v) {
         case LP11_LPD:
 #ifndef NOI2C
             lp11_i2c_write(LP11_I2C_LPB, v) ;
-            lp11_delay = 0 ;
-            lpcheck = true ;
 #else
             lpd = v ;
 #endif
+            lpcheck = true ;
+            cpu.events.schedule(EV_LP, LP11_DELAY) ;
             break;
         default:
             gprintf("lp11: write to invalid address %06o", a);
@@ -95,18 +94,14 @@ void LP11::reset() {
     lpcheck = false ;
 }
 
+// step is called LP11_DELAY instructions after a character went out and
+// again every LP11_DELAY instructions until the printer reports ready
 void LP11::step() {
-#ifndef NOI2C
     if (!lpcheck) {
         return ;
     }
 
-    if (lp11_delay++ < 200) {
-        return ;
-    }
-
-    lp11_delay = 0 ;
-
+#ifndef NOI2C
     u16 lps = lp11_i2c_read(LP11_I2C_LPS) ;
 
 #endif
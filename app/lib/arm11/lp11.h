@@ -6,11 +6,14 @@
 #define LP11_LPS 017777514
 #define LP11_LPD 017777516
 
+#define LP11_DELAY 201
+
 class LP11 : public XX11 {
 
   public:
     void step();
     void reset();
+    inline bool busy() { return lpcheck; }
     virtual u16 read16(const u32 a);
     virtual void write16(const u32 a, const u16 v);
 
@@ -18,9 +18,6 @@ const u8 PC11_I2C_PPB = 056 ;
 const u8 PC11_I2C_RST = 060 ;
 extern CI2CMaster *pI2cMaster ;
 
-int ptp_delay = 0 ;
-int ptr_delay = 0 ;
-
 static u16 pc11_i2c_read(const u8 addr) {
     u8 result[3] = {0, 0, 0} ;
     int r = pI2cMaster->WriteReadRepeatedStart(I2C_SLAVE, &addr, 1, result, 3) ;
@@ -82,13 +79,13 @@ void PC11::write16(const u32 a, const u16 v) {
         case PC11_PRS:
 #ifndef NOI2C
             pc11_i2c_write(PC11_I2C_PRS, v) ;
-            if (v & 01) {
-                ptr_delay = 0 ;
-                ptrcheck = true ;
-            }
 #else
             prs = v | 0100200 ;
 #endif
+            if (v & 01) {
+                ptrcheck = true ;
+                cpu.events.schedule(EV_PTR, PTR_DELAY) ;
+            }
             break;
         case PC11_PRB:
             break ; //read-only
@@ -109,11 +106,11 @@ void PC11::write16(const u32 a, const u16 v) {
         case PC11_PPB:
 #ifndef NOI2C
             pc11_i2c_write(PC11_I2C_PPB, v) ;
-            ptp_delay = 0 ;
-            ptpcheck = true ;
 #else
             ppb = v ;
 #endif
+            ptpcheck = true ;
+            cpu.events.schedule(EV_PTP, PTP_DELAY) ;
             break;
         default:
             gprintf("pc11::write16 invalid write to %06o\n", a);
@@ -130,23 +127,12 @@ void PC11::reset() {
 #endif
 }
 
-void PC11::step() {
-    ptr_step() ;
-    ptp_step() ;
-}
-
 void PC11::ptr_step() {
-#ifndef NOI2C
     if (!ptrcheck) {
         return ;
     }
 
-    if (ptr_delay++ < 200) {
-        return ;
-    }
-
-    ptr_delay = 0 ;
-
+#ifndef NOI2C
     u16 prs = pc11_i2c_read(PC11_I2C_PRS) ;
 #endif
     if (prs & 0200) {
@@ -160,17 +146,11 @@ void PC11::ptr_step() {
 }
 
 void PC11::ptp_step() {
-#ifndef NOI2C
     if (!ptpcheck) {
         return ;
     }
 
-    if (ptp_delay++ < 75000) {
-        return ;
-    }
-
-    ptp_delay = 0 ;
-
+#ifndef NOI2C
     u16 pps = pc11_i2c_read(PC11_I2C_PPS) ;
 #endif
     if (pps & 0200) {
@@ -8,15 +8,19 @@
 #define PC11_PPS 017777554
 #define PC11_PPB 017777556
 
+#define PTR_DELAY 201
+#define PTP_DELAY 75001
+
 class PC11 : public XX11 {
     public:
         virtual u16 read16(const u32 a);
         virtual void write16(const u32 a, const u16 v) ;
         void reset() ;
-        void step() ;
-
-    private:
         void ptr_step() ;
         void ptp_step() ;
+        inline bool ptrbusy() { return ptrcheck; }
+        inline bool ptpbusy() { return ptpcheck; }
+
+    private:
         bool ptrcheck, ptpcheck ;
 } ;
\ No newline at end of file
@@ -0,0 +1,575 @@
+#include "rh70.h"
+
+#include <circle/logger.h>
+#include <circle/timer.h>
+#include "arm11.h"
+#include "kb11.h"
+
+extern KB11 cpu;
+
+// registers, by word offset from RH70_CS1
+enum RHREG : u8 {
+    RH_CS1, RH_WC, RH_BA, RH_DA, RH_CS2, RH_DS, RH_ER1, RH_AS, RH_LA, RH_DB, RH_MR,
+    RH_DT, RH_SN, RH_OF, RH_DC, RH_CC, RH_ER2, RH_ER3, RH_EC1, RH_EC2, RH_BAE, RH_CS3
+} ;
+
+// registers that live in the selected drive rather than in the controller
+#define RH_DRIVEREGS ((1 << RH_DA) | (1 << RH_DS) | (1 << RH_ER1) | (1 << RH_LA) | (1 << RH_MR) | \
+    (1 << RH_DT) | (1 << RH_SN) | (1 << RH_OF) | (1 << RH_DC) | (1 << RH_CC) | \
+    (1 << RH_ER2) | (1 << RH_ER3) | (1 << RH_EC1) | (1 << RH_EC2))
+
+enum {
+    CS1_SC = 0100000, CS1_TRE = 040000, CS1_MCPE = 020000, CS1_DVA = 04000,
+    CS1_A17 = 01400, CS1_RDY = 0200, CS1_IE = 0100, CS1_FNC = 076, CS1_GO = 01
+} ;
+
+enum {
+    CS2_DLT = 0100000, CS2_WCE = 040000, CS2_UPE = 020000, CS2_NED = 010000, CS2_NEM = 04000,
+    CS2_PGE = 02000, CS2_MXF = 01000, CS2_MDPE = 0400, CS2_OR = 0200, CS2_IR = 0100,
+    CS2_CLR = 040, CS2_PAT = 020, CS2_BAI = 010, CS2_UNIT = 07,
+    CS2_ERR = 0177400
+} ;
+
+enum {
+    DS_ATA = 0100000, DS_ERR = 040000, DS_PIP = 020000, DS_MOL = 010000, DS_DPR = 0400,
+    DS_DRY = 0200, DS_VV = 0100, DS_OM = 01
+} ;
+
+enum {
+    ER1_OPI = 020000, ER1_IAE = 02000, ER1_AOE = 01000, ER1_RMR = 04, ER1_ILF = 01
+} ;
+
+// function codes, CS1 bits 5 to 0 with GO
+enum RHFNC : u8 {
+    FNC_NOP = 001, FNC_UNLOAD = 003, FNC_SEEK = 005, FNC_RECAL = 007, FNC_DCLR = 011,
+    FNC_RELEASE = 013, FNC_OFFSET = 015, FNC_RETURN = 017, FNC_PRESET = 021, FNC_PACK = 023,
+    FNC_SEARCH = 031, FNC_WCHK = 051, FNC_WCHKH = 053, FNC_WRITE = 061, FNC_WRITEH = 063,
+    FNC_READ = 071, FNC_READH = 073
+} ;
+
+struct RPGeometry {
+    const char *ext ;
+    u16 dt ;
+    u16 cyl, surf, sect ;
+    const DiskTiming *timing ;
+} ;
+
+static const RPGeometry rptypes[RP_NONE] = {
+    {"RP04", 020020, 411, 19, 22, &RP06_TIMING},
+    {"RP06", 020022, 815, 19, 22, &RP06_TIMING},
+    {"RM03", 020024, 823,  5, 32, &RM05_TIMING},
+    {"RM05", 020027, 823, 19, 32, &RM05_TIMING}
+} ;
+
+#define RH_WORDS 256 // words a sector
+
+// what transfer() does with the track buffer once the read is in
+enum RHPost : u8 {
+    RX_NONE,
+    RX_CHECK, // compare it with core, a write check
+    RX_STORE  // put its last word in core, a read with BAI
+} ;
+#define RH_SEEK 20   // iterations a seek takes at least
+
+RH70::RH70() {
+    for (u8 u = 0; u < RH70_DRIVES; u++) {
+        drives[u].type = RP_NONE ;
+        drives[u].ds = drives[u].er1 = drives[u].da = drives[u].dc = drives[u].cc = 0 ;
+        drives[u].mr = drives[u].of = drives[u].seek = 0 ;
+        drives[u].seekdue = 0 ;
+    }
+    la = 0 ;
+}
+
+u32 RH70::size(const RPTYPE t) {
+    return (u32) rptypes[t].cyl * rptypes[t].surf * rptypes[t].sect * RH_WORDS * 2 ;
+}
+
+const char *RH70::name(const RPTYPE t) {
+    return rptypes[t].ext ;
+}
+
+u16 RH70::read16(u32 a) {
+    const u8 reg = (a - RH70_CS1) >> 1 ;
+    const u8 u = cs2 & CS2_UNIT ;
+    RPDrive &d = drives[u] ;
+
+    if (((1 << reg) & RH_DRIVEREGS) && d.type == RP_NONE) {
+        cs2 |= CS2_NED ;
+        cs1 |= CS1_TRE ;
+        return 0 ;
+    }
+
+    switch (reg) {
+        case RH_CS1: {
+                u16 v = (cs1 & (CS1_TRE | CS1_MCPE | CS1_RDY | CS1_IE | CS1_FNC)) | ((ba >> 8) & CS1_A17) ;
+                if (d.type != RP_NONE) {
+                    v |= CS1_DVA ;
+                }
+                if ((d.ds & DS_PIP) || (xfer && xunit == u)) {
+                    v |= CS1_GO ;
+                }
+                if ((v & (CS1_TRE | CS1_MCPE)) || attn) {
+                    v |= CS1_SC ;
+                }
+                return v ;
+            }
+        case RH_WC:
+            return wc ;
+        case RH_BA:
+            return ba & 0177776 ;
+        case RH_DA:
+            return d.da ;
+        case RH_CS2:
+            return cs2 | CS2_OR | CS2_IR ;
+        case RH_DS: {
+                u16 v = (d.ds & (DS_PIP | DS_VV | DS_OM)) | DS_MOL | DS_DPR ;
+                if (!(d.ds & DS_PIP) && !(xfer && xunit == u)) {
+                    v |= DS_DRY ;
+                }
+                if (d.er1) {
+                    v |= DS_ERR ;
+                }
+                if (attn & (1 << u)) {
+                    v |= DS_ATA ;
+                }
+                return v ;
+            }
+        case RH_ER1:
+            return d.er1 ;
+        case RH_AS:
+            return attn ;
+        case RH_LA:
+            return (la++ % rptypes[d.type].sect) << 6 ;
+        case RH_MR:
+            return d.mr ;
+        case RH_DT:
+            return rptypes[d.type].dt ;
+        case RH_SN:
+            return u + 1 ; // BCD
+        case RH_OF:
+            return d.of ;
+        case RH_DC:
+            return d.dc ;
+        case RH_CC:
+            return d.cc ;
+        case RH_BAE:
+            return (ba >> 16) & 077 ;
+        case RH_CS3:
+            return cs1 & CS1_IE ;
+        case RH_DB:
+        case RH_ER2:
+        case RH_ER3:
+        case RH_EC1:
+        case RH_EC2:
+            return 0 ;
+
+        default:
+            CLogger::Get()->Write("RH70", LogError, "read16 non-existent address %08o", a) ;
+            cpu.errorRegister = 020 ;
+            trap(INTBUS);
+    }
+
+    return 0 ;
+}
+
+void RH70::write16(u32 a, u16 v) {
+    const u8 reg = (a - RH70_CS1) >> 1 ;
+    const u8 u = cs2 & CS2_UNIT ;
+    RPDrive &d = drives[u] ;
+
+    if (((1 << reg) & RH_DRIVEREGS) && d.type == RP_NONE) {
+        cs2 |= CS2_NED ;
+        cs1 |= CS1_TRE ;
+        return ;
+    }
+
+    switch (reg) {
+        case RH_CS1: {
+                if (v & CS1_TRE) {
+                    cs1 &= ~(CS1_TRE | CS1_MCPE) ;
+                    cs2 &= ~CS2_ERR ;
+                }
+
+                const bool ie = cs1 & CS1_IE ;
+                if (cs1 & CS1_RDY) {
+                    ba = (ba & ~0600000) | ((u32)(v & CS1_A17) << 8) ;
+                }
+                cs1 = (cs1 & ~(CS1_IE | CS1_FNC)) | (v & (CS1_IE | CS1_FNC)) ;
+                if (!(v & CS1_IE)) {
+                    cpu.clearIRQ(INTRH) ;
+                } else if (!ie && !(v & CS1_GO)) {
+                    irq() ; // setting IE while ready interrupts right away
+                }
+
+                if (v & CS1_GO) {
+                    go(u, v & 077) ;
+                }
+            }
+            break ;
+        case RH_WC:
+        case RH_BA:
+        case RH_BAE:
+            if (!(cs1 & CS1_RDY)) {
+                cs2 |= CS2_PGE ; // not while a transfer is under way
+                cs1 |= CS1_TRE ;
+                break ;
+            }
+            if (reg == RH_WC) {
+                wc = v ;
+            } else if (reg == RH_BA) {
+                ba = (ba & ~0177777) | (v & 0177776) ;
+            } else {
+                ba = (ba & 0177777) | ((u32)(v & 077) << 16) ;
+            }
+            break ;
+        case RH_DA:
+            d.da = v & 017437 ;
+            break ;
+        case RH_CS2:
+            if (v & CS2_CLR) {
+                clear() ;
+                break ;
+            }
+            cs2 = (cs2 & ~(CS2_PAT | CS2_BAI | CS2_UNIT)) | (v & (CS2_PAT | CS2_BAI | CS2_UNIT)) ;
+            break ;
+        case RH_ER1:
+            d.er1 = v ;
+            break ;
+        case RH_AS:
+            attn &= ~v ;
+            break ;
+        case RH_MR:
+            d.mr = v ;
+            break ;
+        case RH_OF:
+            d.of = v ;
+            break ;
+        case RH_DC:
+            d.dc = v & 01777 ;
+            break ;
+        case RH_CS3:
+            cs1 = (cs1 & ~CS1_IE) | (v & CS1_IE) ;
+            break ;
+        case RH_DS:
+        case RH_LA:
+        case RH_DB:
+        case RH_DT:
+        case RH_SN:
+        case RH_CC:
+        case RH_ER2:
+        case RH_ER3:
+        case RH_EC1:
+        case RH_EC2:
+            break ; // read only, or not emulated
+
+        default:
+            CLogger::Get()->Write("RH70", LogError, "write16 non-existent address %08o : %06o", a, v) ;
+            cpu.errorRegister = 020 ;
+            trap(INTBUS);
+    }
+}
+
+// go starts function fnc on drive u. Positioning functions run on every
+// drive at once and end with an attention, a data transfer holds the
+// controller until it is through.
+void RH70::go(const u8 u, const u8 fnc) {
+    RPDrive &d = drives[u] ;
+    if (d.type == RP_NONE) {
+        cs2 |= CS2_NED ;
+        cs1 |= CS1_TRE ;
+        if (cs1 & CS1_RDY) {
+            irq() ;
+        }
+        return ;
+    }
+    const RPGeometry &t = rptypes[d.type] ;
+
+    if ((d.ds & DS_PIP) || (xfer && xunit == u)) {
+        d.er1 |= ER1_RMR ;
+        attention(u) ;
+        return ;
+    }
+
+    switch (fnc) {
+        case FNC_NOP:
+        case FNC_RELEASE:
+            break ;
+
+        case FNC_DCLR:
+            d.er1 = 0 ;
+            attn &= ~(1 << u) ;
+            break ;
+
+        case FNC_PRESET:
+            d.da = d.dc = d.of = 0 ;
+            d.ds = (d.ds & ~DS_OM) | DS_VV ;
+            break ;
+
+        case FNC_PACK:
+            d.ds |= DS_VV ;
+            break ;
+
+        case FNC_UNLOAD:
+        case FNC_RECAL:
+        case FNC_SEEK:
+        case FNC_SEARCH:
+        case FNC_OFFSET:
+        case FNC_RETURN: {
+                if (fnc == FNC_UNLOAD || fnc == FNC_RECAL) {
+                    d.dc = 0 ;
+                } else if (fnc == FNC_OFFSET) {
+                    d.ds |= DS_OM ;
+                } else if (fnc == FNC_RETURN) {
+                    d.ds &= ~DS_OM ;
+                    d.of = 0 ;
+                }
+
+                if (d.dc >= t.cyl || (fnc == FNC_SEARCH && (((d.da >> 8) & 037) >= t.surf || (d.da & 037) >= t.sect))) {
+                    d.er1 |= ER1_IAE ;
+                    attention(u) ;
+                    break ;
+                }
+
+                const u32 dist = d.dc > d.cc ? d.dc - d.cc : d.cc - d.dc ;
+                d.ds |= DS_PIP ;
+                d.seek = RH_SEEK ;
+                d.seekdue = 0 ;
+                if (IOEngine::latency) {
+                    if (fnc == FNC_SEARCH) {
+                        d.seekdue = IOEngine::due(*t.timing, dist, d.da & 037, 0) ;
+                    } else {
+                        d.seekdue = CTimer::GetClockTicks64() + (dist ? t.timing->settle + (dist - 1) * t.timing->step : 0) ;
+                    }
+                    headcyl[u] = d.dc ;
+                }
+                cpu.events.schedule(EV_RH, 1) ;
+            }
+            break ;
+
+        case FNC_WCHK:
+        case FNC_WCHKH:
+        case FNC_WRITE:
+        case FNC_WRITEH:
+        case FNC_READ:
+        case FNC_READH:
+            if (!(cs1 & CS1_RDY)) {
+                cs2 |= CS2_PGE ;
+                cs1 |= CS1_TRE ;
+                break ;
+            }
+            cs1 &= ~(CS1_RDY | CS1_TRE | CS1_MCPE) ;
+            cs2 &= ~CS2_ERR ;
+            cpu.clearIRQ(INTRH) ;
+            xfer = true ;
+            xunit = u ;
+            xfnc = fnc ;
+            xfirst = true ;
+            xleft = wc ? 0200000 - wc : 0200000 ;
+            cpu.events.schedule(EV_RH, 1) ;
+            break ;
+
+        default:
+            d.er1 |= ER1_ILF ;
+            attention(u) ;
+            break ;
+    }
+}
+
+void RH70::attention(const u8 u) {
+    attn |= 1 << u ;
+    if (cs1 & CS1_RDY) {
+        irq() ;
+    }
+}
+
+void RH70::irq() {
+    if (cs1 & CS1_IE) {
+        cpu.interrupt(INTRH, 5) ;
+    }
+}
+
+// clear is the controller clear, by CS2 CLR or the UNIBUS INIT
+void RH70::clear() {
+    cs1 = CS1_RDY ;
+    cs2 = 0 ;
+    wc = 0 ;
+    ba = 0 ;
+    attn = 0 ;
+    xfer = false ;
+    xpost = RX_NONE ;
+    for (u8 u = 0; u < RH70_DRIVES; u++) {
+        drives[u].er1 = 0 ;
+        if (drives[u].ds & DS_PIP) {
+            drives[u].ds &= ~DS_PIP ;
+            drives[u].cc = drives[u].dc ;
+        }
+    }
+    cpu.clearIRQ(INTRH) ;
+}
+
+void RH70::reset() {
+    clear() ;
+}
+
+bool RH70::busy() {
+    if (xfer) {
+        return true ;
+    }
+    for (u8 u = 0; u < RH70_DRIVES; u++) {
+        if (drives[u].ds & DS_PIP) {
+            return true ;
+        }
+    }
+    return false ;
+}
+
+void RH70::step() {
+    for (u8 u = 0; u < RH70_DRIVES; u++) {
+        RPDrive &d = drives[u] ;
+        if (!(d.ds & DS_PIP)) {
+            continue ;
+        }
+        if (d.seek) {
+            d.seek-- ;
+            continue ;
+        }
+        if (d.seekdue && CTimer::GetClockTicks64() < d.seekdue) {
+            continue ;
+        }
+        d.ds &= ~DS_PIP ;
+        d.cc = d.dc ;
+        attention(u) ;
+    }
+
+    if (xfer) {
+        transfer() ;
+    }
+}
+
+// transfer hands the I/O engine one track a step, straight from or into core.
+// Like the real drive it goes on to the next surface and cylinder on its own.
+void RH70::transfer() {
+    if (iowait || (iodue && CTimer::GetClockTicks64() < iodue)) { // track still on its way
+        return ;
+    }
+
+    RPDrive &d = drives[xunit] ;
+    const RPGeometry &t = rptypes[d.type] ;
+    const bool bai = (cs2 & CS2_BAI) != 0 ;
+
+    if (xpost == RX_CHECK) {
+        for (u32 i = 0; i < xwords; i++) {
+            if (track[i] != xmem[bai ? 0 : i]) {
+                cs2 |= CS2_WCE ;
+                cs1 |= CS1_TRE ;
+                break ;
+            }
+        }
+    } else if (xpost == RX_STORE && (cs1 & CS1_TRE) == 0) {
+        *xmem = track[xwords - 1] ;
+    }
+    xpost = RX_NONE ;
+
+    if (!xleft || (cs1 & CS1_TRE)) {
+        done() ;
+        return ;
+    }
+    if (cpu.io.room() < 2) { // the track and the zero fill
+        return ;
+    }
+
+    u16 trk = (d.da >> 8) & 037, sec = d.da & 037 ;
+    if (d.dc >= t.cyl || trk >= t.surf || sec >= t.sect) {
+        d.er1 |= xfirst ? ER1_IAE : ER1_AOE ;
+        cs1 |= CS1_TRE ;
+        done() ;
+        return ;
+    }
+    xfirst = false ;
+
+    u32 words = (t.sect - sec) * RH_WORDS ;
+    if (words > xleft) {
+        words = xleft ;
+    }
+
+    const bool check = xfnc == FNC_WCHK || xfnc == FNC_WCHKH ;
+    const bool w = xfnc == FNC_WRITE || xfnc == FNC_WRITEH ;
+    IORequest r = {&d.image, ((d.dc * t.surf + trk) * t.sect + sec) * RH_WORDS * 2u, 0, 0, w ? IO_WRITE : IO_READ, EV_RH, true} ;
+    u32 span = bai ? 1 : words ;
+    u16 *m = cpu.unibus.mb_span(ba, span) ;
+    if (!m) {
+        cs2 |= CS2_NEM ;
+        cs1 |= CS1_TRE ;
+        done() ;
+        return ;
+    }
+    if (!bai) {
+        words = span ; // the end of memory cuts the run
+    }
+
+    if (check || (bai && !w)) {
+        r.buf = track ;
+        xpost = check ? RX_CHECK : RX_STORE ;
+        xmem = m ;
+        xwords = words ;
+    } else if (bai) {
+        for (u32 i = 0; i < words; i++) {
+            track[i] = *m ;
+        }
+        r.buf = track ;
+    } else {
+        r.buf = m ;
+    }
+    r.len = words * 2 ;
+    cpu.io.post(r) ;
+    iowait++ ;
+    if (w && (words % RH_WORDS)) { // short write, fill the rest of the sector with zeros
+        static u16 zero[RH_WORDS] = {0} ;
+        r.pos += r.len ;
+        r.buf = zero ;
+        r.len = (RH_WORDS - words % RH_WORDS) * 2 ;
+        cpu.io.post(r) ;
+        iowait++ ;
+    }
+
+    const u32 n = (words + RH_WORDS - 1) / RH_WORDS ;
+    if (IOEngine::latency) {
+        iodue = IOEngine::due(*t.timing, d.dc > headcyl[xunit] ? d.dc - headcyl[xunit] : headcyl[xunit] - d.dc, sec, n) ;
+        headcyl[xunit] = d.dc ;
+    }
+
+    if (!bai) {
+        ba = (ba + words * 2) & 017777776 ;
+    }
+    wc = (wc + words) & 0177777 ;
+    xleft -= words ;
+    d.cc = d.dc ;
+
+    sec += n ;
+    if (sec >= t.sect) {
+        sec = 0 ;
+        if (++trk >= t.surf) {
+            trk = 0 ;
+            d.dc++ ;
+        }
+    }
+    d.da = (trk << 8) | sec ;
+}
+
+void RH70::done() {
+    xfer = false ;
+    cs1 |= CS1_RDY ;
+    if (drives[xunit].er1) {
+        attn |= 1 << xunit ;
+    }
+    irq() ;
+}
+
+void RH70::iodone(const bool ok) {
+    iowait-- ;
+    if (!ok) {
+        drives[xunit].er1 |= ER1_OPI ; // transfer ran off the end of the image
+        cs1 |= CS1_TRE ;
+    }
+}
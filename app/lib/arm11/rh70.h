@@ -0,0 +1,81 @@
+#pragma once
+
+#include <circle/types.h>
+#include "disk.h"
+#include "xx11.h"
+
+#define RH70_CS1 017776700
+#define RH70_CS3 017776752 // last register
+
+#define RH70_DRIVES 8
+#define RH70_TRACK 8192 // words on the longest track, 32 sectors of an RM03 or RM05
+
+// MASSBUS drive types
+enum RPTYPE : u8 {
+    RP04,
+    RP06,
+    RM03,
+    RM05,
+    RP_NONE
+} ;
+
+struct RPDrive {
+    RPTYPE type ;
+    DiskImage image ;
+    u16 ds, er1, da, dc, cc, mr, of ;
+    u16 seek ;    // iterations until the heads have moved, PIP is on while seeking
+    u64 seekdue ; // and the host time, when LATENCY=ON
+} ;
+
+/*
+ * RH70 MASSBUS controller with up to eight RP04/RP06/RM03/RM05 drives. The
+ * RH70 sits on the memory bus of the 11/70 and addresses all 22 bits of core
+ * on its own, data skip the UNIBUS map. Seeks run on every drive at once and
+ * end with an attention interrupt, transfers go a whole track at a time.
+ * A write check reads the track and compares it with core, with BAI set the
+ * bus address stays on one word for the whole transfer.
+ */
+class RH70 : public XX11 {
+    public:
+        RH70() ;
+
+        virtual u16 read16(u32 a) ;
+        virtual void write16(u32 a, u16 v) ;
+        void reset() ;
+        void step() ;
+        bool busy() ;
+        void iodone(const bool ok) ;
+
+        // size is the image size of drive type t, name its file extension
+        static u32 size(const RPTYPE t) ;
+        static const char *name(const RPTYPE t) ;
+
+        RPDrive drives[RH70_DRIVES] ;
+    private:
+        u16 cs1, wc, cs2 ;
+        u32 ba ;     // 22 bit bus address, BAE holds bits 21 to 16
+        u8 attn ;    // attention summary, one bit a drive
+        u8 la ;      // look ahead, the sector under the heads
+
+        bool xfer = false ; // a data transfer is under way
+        u8 xunit, xfnc ;    // on this drive, with this function
+        bool xfirst ;       // no track of it posted yet
+        u32 xleft ;         // words still to go
+        u8 iowait = 0 ;     // requests still with the I/O engine
+        u64 iodue = 0 ;     // host time the track in flight is through
+        u16 headcyl[RH70_DRIVES] = {0} ;
+
+        // a track read for a write check or a read with BAI lands in track first,
+        // the next step compares it with core or stores its last word
+        u16 track[RH70_TRACK] ;
+        u8 xpost = 0 ;      // what is left to do with it
+        u16 *xmem ;         // the core it goes with
+        u32 xwords ;
+
+        void clear() ;
+        void go(const u8 u, const u8 fnc) ;
+        void attention(const u8 u) ;
+        void done() ;
+        void transfer() ;
+        void irq() ;
+} ;
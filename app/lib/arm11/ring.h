@@ -0,0 +1,57 @@
+#pragma once
+
+#include <circle/types.h>
+
+/*
+ * A ring of bytes with a single producer and a single consumer, the two may
+ * be an interrupt handler and the emulator core. Each side only moves its
+ * own index, so no lock is taken. N is a power of two.
+ */
+template <u32 N>
+class ByteRing {
+    public:
+        // producer side
+        inline bool put(const u8 c) {
+            if (head - __atomic_load_n(&tail, __ATOMIC_ACQUIRE) >= N) {
+                return false ;
+            }
+            buf[head & (N - 1)] = c ;
+            __atomic_store_n(&head, head + 1, __ATOMIC_RELEASE) ;
+            return true ;
+        }
+        inline u32 room() {
+            return N - (head - __atomic_load_n(&tail, __ATOMIC_ACQUIRE)) ;
+        }
+
+        // consumer side
+        inline bool get(u8 &c) {
+            if (__atomic_load_n(&head, __ATOMIC_ACQUIRE) == tail) {
+                return false ;
+            }
+            c = buf[tail & (N - 1)] ;
+            __atomic_store_n(&tail, tail + 1, __ATOMIC_RELEASE) ;
+            return true ;
+        }
+        // peek hands out the bytes up to the end of the buffer in one piece, drop takes n of them
+        inline u32 peek(const u8 *&p) {
+            const u32 n = __atomic_load_n(&head, __ATOMIC_ACQUIRE) - tail ;
+            const u32 o = tail & (N - 1) ;
+            p = buf + o ;
+            return n < N - o ? n : N - o ;
+        }
+        inline void drop(const u32 n) {
+            __atomic_store_n(&tail, tail + n, __ATOMIC_RELEASE) ;
+        }
+        inline bool empty() {
+            return __atomic_load_n(&head, __ATOMIC_ACQUIRE) == tail ;
+        }
+
+        // clear empties the ring, only while neither side runs
+        inline void clear() {
+            head = tail = 0 ;
+        }
+
+    private:
+        u8 buf[N] ;
+        u32 head = 0, tail = 0 ;
+} ;
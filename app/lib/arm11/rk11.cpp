@@ -2,6 +2,8 @@
 #include "kb11.h"
 #include "rk11.h"
 
+#include <circle/timer.h>
+
 extern KB11 cpu;
 #define SETMASK(l, r, m) l = (((l)&~(m)) | ((r)&(m)))
 
@@ -65,33 +67,29 @@ void RK11::step() {
         case 2: // read
         case 3:
             rknotready();
-            seek();
             readwrite();
             return;
         case 6: // Drive Reset - falls through to be finished as a seek
             rker = 0;
             [[fallthrough]];
         case 4: // Seek (and drive reset) - complete immediately
-            rknotready();
             // if (drive != 0) {
             //     rker |= 0x80; // NXD
             //     rkready();
             //     cpu.interrupt(INTRK, 5);
             //     return;
             // }
-            seek();
             rkcs &= ~0x2000; // Clear search complete - reset by rk11_seekEnd
-            rkcs |= 0x80;    // set done - ready to accept new command
+            [[fallthrough]];
+        case 5: // Read Check - nothing to check against, done at once
+        case 7: // Write Lock - not implemented :-(, done at once
+            rkready();       // set done, clear GO - ready to accept new command
             if (rkcs & (1 << 6)) {
                 cpu.interrupt(INTRK, 5);
             } else {
                 cpu.clearIRQ(INTRK) ;
             }
             break;
-        case 5: // Read Check
-            break;
-        case 7: // Write Lock - not implemented :-(
-            break;
         default:
             gprintf("unimplemented RK05 operation %06o\n", ((rkcs & 017) >> 1));
             while (1) ;
@@ -99,6 +97,10 @@ void RK11::step() {
 }
 
 void RK11::readwrite() {
+    if (iowait || (iodue && CTimer::GetClockTicks64() < iodue)) {   // Last sector still on its way
+        return;
+    }
+
     if (rkwc == 0) {
         rkready();
         if (rkcs & (1 << 6)) {
@@ -113,42 +115,48 @@ void RK11::readwrite() {
         return ;
     }
 
+    if (cpu.io.room() < 4) {     // Up to 3 spans and the zero fill
+        return ;
+    }
+
     rkdelay = 0;
 
     bool w = ((rkcs >> 1) & 7) == 1;
-    int i;
-    int zero=0;
-    // int pos = (cylinder * 24 + surface * 12 + sector) * 512;
-    //if (w)
-    //    printf("Write:");
-    //else
-    //    printf("Read: ");
-    //printf(" Block:%d Addr:%o Count:%d RKDA:%o\n", pos / 512, rkba, 65536 - (int)rkwc, rkda);
-
-    for (i = 0; i < 256 && rkwc != 0; i++) {
-	    rkba18 = rkba | (rkcs & 060) << 12;     // Include ext addr bits
-        if (w) {
-            u16 val = cpu.unibus.ub_read16(rkba18);
-            u8 buf[2] = {static_cast<u8>(val & 0xff), static_cast<u8>(val >> 8)} ;
-	        f_write(&crtds[drive], buf, 2, &bcnt); }
-	    else {
-		    u8 buf[2];
-		    f_read(&crtds[drive], buf, 2, &bcnt);
-            cpu.unibus.ub_write16(rkba18, static_cast<u16>(buf[0]) | static_cast<u16>(buf[1]) << 8);
-        }
-        rkba += 2;
-        rkwc++;
-	    if (rkba == 0)                          // Overflow into ext addr bits
-		    SETMASK(rkcs, rkcs + 020, 060);
-		}
-
-    if (w && i < 256) {                           // Fill remainder of sector with zero
-        for (i=i; i<256; i++)
-          f_write(&crtds[drive], &zero, 2, &bcnt) ;
+    u32 pos = (cylinder * 24 + surface * 12 + sector) * DISK_SECTOR;
+    u32 addr = rkba | (rkcs & 060) << 12;   // Include ext addr bits
+    u32 words = 0200000 - rkwc;
+    if (words > 256) {
+        words = 256;
     }
 
-    if (w) {
-        f_sync(&crtds[drive]) ;
+    IORequest r = {&crtds[drive], pos, 0, 0, w ? IO_WRITE : IO_READ, EV_RK, true};
+    for (u32 n = words; n > 0; ) {
+        u32 k = n;
+        r.buf = cpu.unibus.ub_span(addr, k);
+        r.len = k * 2;
+        cpu.io.post(r);
+        iowait++;
+        r.pos += k * 2;
+        addr = (addr + k * 2) & 0777777;
+        n -= k;
+    }
+
+    rkwc += words;
+    rkba = addr;
+    SETMASK(rkcs, addr >> 12, 060);             // Overflow into ext addr bits
+
+    if (w && words < 256) {                     // Fill remainder of sector with zero
+        static u16 zero[256] = {0};
+        r.buf = zero;
+        r.len = (256 - words) * 2;
+        cpu.io.post(r);
+        iowait++;
+    }
+
+    if (IOEngine::latency) {
+        const u32 d = cylinder > headcyl[drive] ? cylinder - headcyl[drive] : headcyl[drive] - cylinder;
+        iodue = IOEngine::due(RK05_TIMING, d, sector, 1);
+        headcyl[drive] = cylinder;
     }
 
     sector++;
@@ -167,12 +175,11 @@ void RK11::readwrite() {
     }
 }
 
-void RK11::seek() {
-    const u32 pos = (cylinder * 24 + surface * 12 + sector) * 512;
-	if (FR_OK != (fr = f_lseek(&crtds[drive], pos))) {
-		gprintf(("rkstep: failed to seek\r\n"));
-		while (1) ;
-	}
+void RK11::iodone(const bool ok) {
+    iowait--;
+    if (!ok) {
+        rker |= RKNXS;          // Sector beyond the end of the image
+    }
 }
 
 void RK11::write16(const u32 a, const u16 v) {
@@ -180,6 +187,9 @@ void RK11::write16(const u32 a, const u16 v) {
     switch (a) {
         case 017777404:
             rkcs =  (v & ~0xf080) | (rkcs & 0xf080); // Bits 7 and 12 - 15 are read only
+            if (rkcs & 01) {
+                cpu.events.schedule(EV_RK, 1) ;
+            }
             break;
         case 017777406:
             rkwc = v;
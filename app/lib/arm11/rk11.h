@@ -1,7 +1,7 @@
 #pragma once
 
 #include <circle/types.h>
-#include <fatfs/ff.h>
+#include "disk.h"
 #include "xx11.h"
 
 #define RK11_CSR 017777400
@@ -9,21 +9,23 @@
 class RK11 : public XX11 {
 
   public:
-	  FIL crtds[8];
+	  DiskImage crtds[8];
     virtual u16 read16(const u32 a);
     virtual void write16(const u32 a, const u16 v);
     void reset();
     void step();
-	  FRESULT fr;
+    inline bool busy() { return rkcs & 01; }
+    void iodone(const bool ok);
 
   private:
 	  u16 rkds, rker, rkcs, rkwc, rkba, rkda;
-	  UINT bcnt;
-    u32 sector, surface, cylinder,rkba18,rkdelay;
+    u32 sector, surface, cylinder,rkdelay;
     u8 drive ;
+    u8 iowait = 0;              // requests still with the I/O engine
+    u64 iodue = 0;              // modelled end of the last transfer
+    u16 headcyl[8] = {0};       // where each drive's arm is, for the latency model
 
     void rknotready();
     void rkready();
     void readwrite();
-    void seek();
 };
@@ -41,6 +41,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "arm11.h"
 #include "kb11.h"
 
+#include <circle/timer.h>
+
 extern KB11 cpu;
 extern u64 systime;
 
@@ -115,10 +117,16 @@ void rlerror(u16 e) {
 void RL11::step() {
     if (!drun)
         return;
-    if (drun-- > 1)
+    if (drun > 1) {
+        drun--;
         return;
-
-    RLCS &= ~1;
+    }
+    if (iowait || (iodue && CTimer::GetClockTicks64() < iodue)) {   // Track still on its way
+        return;
+    }
+    if (cpu.io.room() < 5) {            // Up to 4 spans and the zero fill
+        return;
+    }
 
     bool w;
     switch ((RLCS & 017) >> 1) {
@@ -131,11 +139,26 @@ void RL11::step() {
             break;
         default:
             gprintf("%06o unimplemented RL01/2 operation", (RLCS & 017) >> 1) ;
+            drun = 0;
             return ;
     }
 
-retry:
-    s32 pos = GET_DA(RLDA) * 256;
+    if (rlio) {
+        if (!RLMP) {                    // RLMP (WC) has gone to zero, all tracks are through
+            RLCS |= 1;
+            RLCS = (RLCS & ~060) | ((RLBA & 0600000) >> 12);
+            rlready();
+            drun = 0;
+            rlio = false;
+            return;
+        }
+        RLDA = (RLDA + 0100) & ~077;    // Move to next track and continue
+    }
+    rlio = true;
+
+    RLCS &= ~1;
+
+    u32 pos = GET_DA(RLDA) * 256;
     s32 maxwc = (RL_NUMSC - GET_SECT(RLDA)) * RL_NUMWD;
     s16 wc = 0200000 - RLMP;
 
@@ -143,42 +166,42 @@ retry:
         wc = maxwc;
     }
     RLWC = 65536 - wc;
-	if (FR_OK != (f_lseek(&disks[drive], pos))) {
-        gprintf("%% rlstep: failed to seek\r\n");
-        while (1);
+
+    u32 words = RLWC ? 0200000 - RLWC : 0;
+    IORequest r = {&disks[drive], pos, 0, 0, w ? IO_WRITE : IO_READ, EV_RL, true};
+    for (u32 n = words; n > 0; ) {
+        u32 k = n;
+        r.buf = cpu.unibus.ub_span(RLBA, k);
+        r.len = k * 2;
+        cpu.io.post(r);
+        iowait++;
+        r.pos += k * 2;
+        RLBA += k * 2;
+        n -= k;
     }
-    u16 i=0;
-    u16 val;
-    while (RLWC) {
-        if (w) {
-            val = cpu.unibus.ub_read16(RLBA);
-            f_write(&disks[drive], &val, 2, &bcnt);
-        } else {
-            f_read(&disks[drive], &val, 2, &bcnt);
-            cpu.unibus.ub_write16(RLBA, val);
-        }
-        RLBA += 2;
-        RLWC++;
-        RLMP++;
-        i++;                            // Count of words transferred
+    RLWC = 0;
+    RLMP += words;
+    if (w && (words % RL_NUMWD)) {      // Short write, fill remaining words in sector with zeros.
+        static u16 zero[RL_NUMWD] = {0};
+        r.buf = zero;
+        r.len = (RL_NUMWD - words % RL_NUMWD) * 2;
+        cpu.io.post(r);
+        iowait++;
     }
-    i &= 0377;
-    val = 0;
-    if (w && !RLMP) {                   // If write AND IO complete (RLMP==0) fill remaining words in sector with zeros.
-        if (i)
-            for (i=i;i<256;i++) {
-                f_write(&disks[drive],&val,2,&bcnt);
-            }
-        f_sync(&disks[drive]) ;
+
+    if (IOEngine::latency) {
+        const u32 c = GET_CYL(RLDA);
+        iodue = IOEngine::due(RL02_TIMING, c > headcyl[drive] ? c - headcyl[drive] : headcyl[drive] - c,
+            GET_SECT(RLDA), (words + RL_NUMWD - 1) / RL_NUMWD);
+        headcyl[drive] = c;
     }
-    if (RLMP) {                         // Has RLMP (WC) gone to zero. If not, move to next track and continue
-        RLDA = (RLDA + 0100) & ~077;
-        goto retry;
+}
+
+void RL11::iodone(const bool ok) {
+    iowait--;
+    if (!ok) {
+        RLCS |= RLCERR | RLOPI;         // Transfer ran off the end of the image
     }
-    RLCS |= 1;
-    RLCS = (RLCS & ~060) | ((RLBA & 0600000) >> 12);
-    rlready();
-    drun = 0;
 }
 
 void RL11::write16(const u32 a, const u16 v) {
@@ -212,6 +235,7 @@ void RL11::write16(const u32 a, const u16 v) {
                 case 6:                    // Read or Write
                     RLWC = RLMP;
                     drun = 2;             // Defer xfer by 2 cpu cycles
+                    cpu.events.schedule(EV_RL, 1) ;
                     RLCS &= ~1;            // Clear Ready
                     break;
                 default:
@@ -244,6 +268,7 @@ void RL11::reset() {
     RLDA = 0;
     RLMP = 0;
     drun = 0;
+    rlio = false;
     drive = 0 ;
     dtype = 0235 ;         // RL02
 }
@@ -35,7 +35,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #pragma once
 
 #include <circle/types.h>
-#include <fatfs/ff.h>
+#include "disk.h"
 #include "xx11.h"
 
 #define RL11_CSR 017774400
@@ -50,19 +50,24 @@ enum {
 class RL11 : public XX11 {
 
 public:
-   FIL disks[4];
+   DiskImage disks[4];
    virtual void write16(const u32 a, const u16 v);
    virtual u16 read16(const u32 a);
    void reset();
    void step();
+   inline bool busy() { return drun; }
    void rlnotready();
    void rlready();
+   void iodone(const bool ok);
 
 private:
     u16 drun, dtype;
     u8 drive ;
     u16 RLWC, RLDA, RLMP, RLCS, RLBAE;
     u32 RLBA;
-    unsigned int bcnt;
+    bool rlio = false;      // a transfer is under way, step() moves it on track by track
+    u8 iowait = 0;          // requests still with the I/O engine
+    u64 iodue = 0;          // modelled end of the last track
+    u16 headcyl[4] = {0};   // where each drive's arm is, for the latency model
 } ;
 
@@ -1,6 +1,7 @@
 #include "tc11.h"
 
 #include <circle/logger.h>
+#include <circle/util.h>
 #include "arm11.h"
 #include "kb11.h"
 
@@ -69,6 +70,7 @@ void TC11::write16(u32 a, u16 v) {
             if (tccm & 1) {
                 tccm &= 0177576 ;
                 drun = DRUN ;
+                cpu.events.schedule(EV_TC, 1) ;
             }
 
             // clear status errors if no command error
@@ -96,12 +98,17 @@ void TC11::reset() {
     tccm = (tccm & 0140201) | 0200 ;  // clear bits 13 through 8, 6 through 1; set bit 7
     tcwc = tcba = tcdt = 0 ;
     unit = 0 ;
+    tcio = false ;
 
     for (u8 u = 0; u < TC11_UNITS; u++) {
         units[u].block = 0 ;
     }
 }
 
+bool TC11::busy() {
+    return drun ;
+}
+
 void TC11::step() {
     if (!drun) {
         return ;
@@ -190,99 +197,9 @@ void TC11::step() {
             }
             break;
 
-        case TCC_RDATA: {
-                // CLogger::Get()->Write("TC11", LogError, "step cmd RDATA %d, block %06o", unit, units[unit].block) ;
-                if (units[unit].block < 0 || units[unit].block > 577) {
-                        tcst &= ~0200 ; // !@speed
-                        tcst |= 0100000 ; // ENDZ
-                        tccm |= 0100200 ; // ERROR, READY
-                } else {
-                    FRESULT fr = f_lseek(&units[unit].file, units[unit].block * TC11_BSZ) ;
-                    if (fr != FR_OK) {
-                        tcst |= 02000 ;
-                        tccm |= 0100200 ; // ERROR, READY
-                        CLogger::Get()->Write("TC11", LogError, "step WDATA seek err %d", fr) ;
-                    } else {
-                        FRESULT fr = FR_OK ;
-                        UINT br ;
-                        while (tcwc != 0 && fr == FR_OK) {
-                            u32 aa = ((u32) tcba) | ((u32)((tccm >> 4) & 3) << 16) ;
-                            u16 word = 0 ;
-                            br = 0 ;
-                            fr = f_read(&units[unit].file, &word, 2, &br) ;
-                            if (fr != FR_OK) {
-                                tcst |= 02000 ;
-                                tccm |= 0100000 ;
-                                CLogger::Get()->Write("TC11", LogError, "step RDATA f_read err %d", fr) ;
-                            } else {
-                                cpu.unibus.ub_write16(aa, word) ;
-                            }
-                            // CLogger::Get()->Write("TC11", LogError, "step cmd WDATA %d, %06o words from %08o to block %d %d", unit, -tcwc, aa, units[unit].block, units[unit].dib) ;
-                            tcwc++ ;
-                            aa += 2 ;
-                            tcba = aa & 0177777 ;
-                            tccm = (tccm & ~060) | ((aa >> 12) & 060) ;
-                        }
-                        tcst &= 077777 ; // !ENDZ
-                        tcst |= 0200 ; // @speed
-                        tccm = (tccm & 077776) | 0200 ; // !ERROR, READY
-                    }
-                }
-
-                drun = 0 ;
-                if (tccm & 0100) {
-                    cpu.interrupt(INTTC, 6) ;
-                } else {
-                    cpu.clearIRQ(INTTC) ;
-                }
-            }
-            break;
-
-        case TCC_WDATA: {
-                // CLogger::Get()->Write("TC11", LogError, "step cmd WDATA %d, block %d", unit, units[unit].block) ;
-                if (units[unit].block < 0 || units[unit].block > 577) {
-                        tcst &= ~0200 ; // !@speed
-                        tcst |= 0100000 ; // ENDZ
-                        tccm |= 0100200 ; // ERROR, READY
-                } else {
-                    FRESULT fr = f_lseek(&units[unit].file, units[unit].block * TC11_BSZ) ;
-                    if (fr != FR_OK) {
-                        tcst |= 02000 ;
-                        tccm |= 0100200 ; // ERROR, READY
-                        CLogger::Get()->Write("TC11", LogError, "step WDATA seek err %d", fr) ;
-                    } else {
-                        FRESULT fr = FR_OK ;
-                        UINT bw ;
-                        while (tcwc != 0 && fr == FR_OK) {
-                            u32 aa = ((u32) tcba) | ((u32)((tccm >> 4) & 3) << 16) ;
-                            u16 word = cpu.unibus.ub_read16(aa) ;
-                            bw = 0 ;
-                            fr = f_write(&units[unit].file, &word, 2, &bw) ;
-                            if (fr != FR_OK) {
-                                tcst |= 02000 ;
-                                tccm |= 0100000 ;
-                                CLogger::Get()->Write("TC11", LogError, "step WDATA f_write err %d", fr) ;
-                            }
-                            // CLogger::Get()->Write("TC11", LogError, "step cmd WDATA %d, %06o words from %08o to block %d %d", unit, -tcwc, aa, units[unit].block, units[unit].dib) ;
-                            tcwc++ ;
-                            aa += 2 ;
-                            tcba = aa & 0177777 ;
-                            tccm = (tccm & ~060) | ((aa >> 12) & 060) ;
-                        }
-                        f_sync(&units[unit].file) ;
-                        tcst &= 077777 ; // !ENDZ
-                        tcst |= 0200 ; // @speed
-                        tccm = (tccm & 077776) | 0200 ; // !ERROR, READY
-                    }
-                }
-
-                drun = 0 ;
-                if (tccm & 0100) {
-                    cpu.interrupt(INTTC, 6) ;
-                } else {
-                    cpu.clearIRQ(INTTC) ;
-                }
-            }
+        case TCC_RDATA:
+        case TCC_WDATA:
+            transfer(cmd == TCC_WDATA) ;
             break;
 
         default:
@@ -290,3 +207,71 @@ void TC11::step() {
             break;
     }
 }
+
+// transfer hands the block to the I/O engine a span at a time, step() comes
+// back until every span is posted and served
+void TC11::transfer(const bool w) {
+    if (!tcio) {
+        // CLogger::Get()->Write("TC11", LogError, "step cmd %s %d, block %06o", w ? "WDATA" : "RDATA", unit, units[unit].block) ;
+        if (units[unit].block < 0 || units[unit].block > 577) {
+            tcst &= ~0200 ; // !@speed
+            tcst |= 0100000 ; // ENDZ
+            tccm |= 0100200 ; // ERROR, READY
+            drun = 0 ;
+            if (tccm & 0100) {
+                cpu.interrupt(INTTC, 6) ;
+            } else {
+                cpu.clearIRQ(INTTC) ;
+            }
+            return ;
+        }
+
+        tcpos = units[unit].block * TC11_BSZ ;
+        tcaddr = ((u32) tcba) | ((u32)((tccm >> 4) & 3) << 16) ;
+        tcerr = false ;
+        tcio = true ;
+    }
+
+    drun = 1 ;
+    IORequest r = {&units[unit].image, 0, 0, 0, w ? IO_WRITE : IO_READ, EV_TC, true} ;
+    while (tcwc != 0 && cpu.io.room()) {
+        u32 k = (u16) -tcwc ;
+        r.buf = cpu.unibus.ub_span(tcaddr, k) ;
+        r.pos = tcpos ;
+        r.len = k * 2 ;
+        cpu.io.post(r) ;
+        iowait++ ;
+        tcpos += k * 2 ;
+        tcwc += k ;
+        tcaddr = (tcaddr + k * 2) & 0777777 ;
+    }
+
+    if (tcwc != 0 || iowait) {
+        return ;
+    }
+
+    tcio = false ;
+    if (tcerr) {
+        tcst |= 02000 ;
+        CLogger::Get()->Write("TC11", LogError, "step %s transfer error, block %d", w ? "WDATA" : "RDATA", units[unit].block) ;
+    }
+    tcba = tcaddr & 0177777 ;
+    tccm = (tccm & ~060) | ((tcaddr >> 12) & 060) ;
+    tcst &= 077777 ; // !ENDZ
+    tcst |= 0200 ; // @speed
+    tccm = (tccm & 077776) | 0200 ; // !ERROR, READY
+
+    drun = 0 ;
+    if (tccm & 0100) {
+        cpu.interrupt(INTTC, 6) ;
+    } else {
+        cpu.clearIRQ(INTTC) ;
+    }
+}
+
+void TC11::iodone(const bool ok) {
+    iowait-- ;
+    if (!ok) {
+        tcerr = true ;
+    }
+}
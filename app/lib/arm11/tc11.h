@@ -1,7 +1,7 @@
 #pragma once
 
 #include <circle/types.h>
-#include <fatfs/ff.h>
+#include "disk.h"
 #include "xx11.h"
 
 #define TC11_ST 017777340
@@ -11,10 +11,11 @@
 #define TC11_DT 017777350
 
 #define TC11_UNITS 1
+#define TC11_SIZE (578 * 512) // blocks 0 to 577
 
 struct TC11Unit {
     int block ;
-    FIL file ;
+    DiskImage image ;
 } ;
 
 class TC11 : public XX11 {
@@ -25,10 +26,19 @@ class TC11 : public XX11 {
         virtual void write16(u32 a, u16 v) ;
         void reset() ;
         void step();
+        bool busy() ;
+        void iodone(const bool ok) ;
 
         TC11Unit units[TC11_UNITS] ;
     private:
         u16 tcst, tccm, tcba, tcdt ;
         s16 tcwc ;
         u8 unit ;
+
+        bool tcio = false ; // a transfer is under way
+        bool tcerr ;
+        u8 iowait = 0 ;     // requests still with the I/O engine
+        u32 tcpos, tcaddr ; // where the transfer goes on
+
+        void transfer(const bool w) ;
 } ;
@@ -149,6 +149,7 @@ void TOY::write16(const u32 a, const u16 v) {
             csr = (csr & ~3) | (v & 3) ;
             if (csr & 3) {
                 csr &= ~0100200 ;
+                cpu.events.schedule(EV_TOY, 1) ;
             }
             break ;
         case TOY_DAR:
@@ -15,6 +15,7 @@ class TOY : public XX11 {
         virtual void write16(const u32 a, const u16 v) ;
         void step() ;
         void reset() ;
+        inline bool busy() { return csr & 3; }
     private:
         bool ds3231_set_time() ;
         u16 csr, dar, tlr, thr ;
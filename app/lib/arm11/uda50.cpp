@@ -0,0 +1,688 @@
+#include "uda50.h"
+
+#include <circle/logger.h>
+#include <circle/timer.h>
+#include <circle/util.h>
+#include "arm11.h"
+#include "kb11.h"
+
+extern KB11 cpu;
+
+// SA, the port side of the initialization handshake
+enum {
+    SA_ER = 0100000, SA_S4 = 040000, SA_S3 = 020000, SA_S2 = 010000, SA_S1 = 04000,
+    SA_S1H_DI = 0400,                                    // step 1, port: extended diagnostics
+    SA_S1C_WR = 040000, SA_S1C_IE = 0200, SA_S1C_VEC = 0177, // step 1, host
+    SA_S3C_PP = 0100000,                                 // step 3, host: purge and poll test
+    SA_S4C_GO = 01                                       // step 4, host
+} ;
+
+#define UDA50_MODEL 6   // port model and microcode version in step 4
+#define UDA50_VERSION 3
+#define PE_HAT 013      // fatal error, host access timeout
+
+enum UQSTATE : u8 {
+    UQ_S1, UQ_S2, UQ_S3, UQ_PP, UQ_S4, UQ_RUN, UQ_FATAL
+} ;
+
+enum SLOTSTATE : u8 {
+    SLOT_FREE, SLOT_CMD, SLOT_XFER, SLOT_END
+} ;
+
+// ring descriptors, high word
+#define DESC_OWN 0100000 // the port owns it
+#define DESC_F   040000  // the host wants an interrupt when it comes back
+
+// interrupt words ahead of the rings
+#define COMM_CI -4
+#define COMM_RI -2
+
+enum MSCPOP : u8 {
+    OP_ABO = 1, OP_GCS = 2, OP_GUS = 3, OP_SCC = 4, OP_AVL = 8, OP_ONL = 9, OP_SUC = 10,
+    OP_DAP = 11, OP_ACC = 16, OP_CCD = 17, OP_ERS = 18, OP_FLU = 19, OP_REP = 20,
+    OP_CMP = 32, OP_RD = 33, OP_WR = 34, OP_END = 0200
+} ;
+
+enum {
+    ST_SUC = 0, ST_ICM = 1, ST_OFL = 3, ST_AVL = 4, ST_CMP = 7, ST_HST = 9, ST_DRV = 11,
+    SB_SUC_ON = 0400,                                   // already online
+    SB_HST_OA = 040, SB_HST_OC = 0100, SB_HST_NXM = 0140,
+    I_OPCD = 8 << 8, I_BCNT = 12 << 8, I_LBN = 28 << 8  // invalid command, offset of the field
+} ;
+
+#define MD_NXU 01 // get unit status of the next unit there is
+
+// message text, by word
+#define M_CRF  0  // command reference number
+#define M_UNIT 2
+#define M_OPC  4  // opcode, end code and flags in an end message
+#define M_MOD  5  // modifiers, status in an end message
+#define M_BCNT 6
+#define M_BUFF 8
+#define M_LBN  14
+
+#define RA_BLOCK 512
+
+struct RAGeometry {
+    const char *ext ;
+    u32 lbn ;
+    u16 sect, surf, tpg, gpc, rcts ;
+    u8 rbns, rctc, mod ;
+    u32 med ;
+} ;
+
+static const RAGeometry ratypes[RA_NONE] = {
+    {"RD54",  311200, 17, 15, 15, 8,    7, 1, 8, 13, 0x25644036},
+    {"RA81",  891072, 51, 14, 14, 1, 2856, 1, 4,  5, 0x25641051},
+    {"RA82", 1216665, 57, 15, 15, 1, 3420, 1, 4, 11, 0x25641052},
+    {"RA92", 2940951, 73, 13, 13, 1,  949, 1, 4, 29, 0x2564105C}
+} ;
+
+static u16 zero[RA_BLOCK / 2] = {0} ;
+
+// verify tells if s reads the medium to check it rather than to move data
+static inline bool verify(const UDA50Slot &s) {
+    const u8 op = s.cmd[M_OPC] & 0377 ;
+    return op == OP_CMP || op == OP_ACC ;
+}
+
+UDA50::UDA50() {
+    for (u8 u = 0; u < UDA50_UNITS; u++) {
+        units[u].type = RA_NONE ;
+        units[u].online = false ;
+        units[u].head = 0 ;
+    }
+    for (u8 i = 0; i < UDA50_SLOTS; i++) {
+        slots[i].state = SLOT_FREE ;
+        slots[i].iowait = 0 ;
+        slots[i].held = 0 ;
+    }
+    s1 = 0 ;
+    init() ;
+}
+
+u32 UDA50::size(const RATYPE t) {
+    return ratypes[t].lbn * RA_BLOCK ;
+}
+
+const char *UDA50::name(const RATYPE t) {
+    return ratypes[t].ext ;
+}
+
+u16 UDA50::read16(u32 a) {
+    switch (a) {
+        case UDA50_IP:
+            if (state == UQ_RUN) { // the host has put something in the command ring
+                polling = true ;
+                cpu.events.schedule(EV_UDA, 1) ;
+            }
+            return 0 ;
+        case UDA50_SA:
+            return sa ;
+
+        default:
+            CLogger::Get()->Write("UDA50", LogError, "read16 non-existent address %08o", a) ;
+            cpu.errorRegister = 020 ;
+            trap(INTBUS);
+    }
+
+    return 0 ;
+}
+
+void UDA50::write16(u32 a, u16 v) {
+    switch (a) {
+        case UDA50_IP:
+            init() ;
+            break ;
+        case UDA50_SA:
+            switch (state) {
+                case UQ_S1:
+                    s1 = v ;
+                    if ((v & SA_S1C_IE) && (v & SA_S1C_VEC) > 077) {
+                        CLogger::Get()->Write("UDA50", LogError, "vector %03o not supported", (v & SA_S1C_VEC) << 2) ;
+                    }
+                    sa = SA_S2 | (v >> 8) ;
+                    state = UQ_S2 ;
+                    irq() ;
+                    break ;
+                case UQ_S2:
+                    comm = v & 0177776 ;
+                    sa = SA_S3 | (s1 & 0377) ;
+                    state = UQ_S3 ;
+                    irq() ;
+                    break ;
+                case UQ_S3:
+                    comm = (comm | ((u32)(v & 077777) << 16)) & 0777776 ;
+                    if (v & SA_S3C_PP) {
+                        sa = 0 ; // the host writes 0 back
+                        state = UQ_PP ;
+                    } else {
+                        rings() ;
+                    }
+                    break ;
+                case UQ_PP:
+                    rings() ;
+                    break ;
+                case UQ_S4:
+                    if (v & SA_S4C_GO) {
+                        sa = 0 ;
+                        state = UQ_RUN ;
+                        polling = true ;
+                        cpu.events.schedule(EV_UDA, 1) ;
+                    }
+                    break ;
+                default:
+                    break ;
+            }
+            break ;
+
+        default:
+            CLogger::Get()->Write("UDA50", LogError, "write16 non-existent address %08o : %06o", a, v) ;
+            cpu.errorRegister = 020 ;
+            trap(INTBUS);
+    }
+}
+
+// init is the hard initialization, by a write to IP or the UNIBUS INIT
+void UDA50::init() {
+    if (s1 & SA_S1C_IE) {
+        cpu.clearIRQ((s1 & SA_S1C_VEC) << 2) ;
+    }
+
+    state = UQ_S1 ;
+    sa = SA_S1 | SA_S1H_DI ;
+    s1 = 0 ;
+    comm = 0 ;
+    cmdn = rspn = 1 ;
+    cmdidx = rspidx = 0 ;
+    polling = false ;
+    credits = UDA50_SLOTS - 1 ;
+    seq = 0 ;
+
+    // a slot with requests still at the I/O engine is taken again once they are back
+    for (u8 i = 0; i < UDA50_SLOTS; i++) {
+        slots[i].state = SLOT_FREE ;
+    }
+    for (u8 u = 0; u < UDA50_UNITS; u++) {
+        units[u].online = false ;
+    }
+}
+
+// rings ends step 3: the ring sizes are known, the communications area is cleared
+void UDA50::rings() {
+    rspn = 1 << ((s1 >> 8) & 7) ;
+    cmdn = 1 << ((s1 >> 11) & 7) ;
+
+    if (!(s1 & SA_S1C_WR)) {
+        for (u32 a = comm - 8; a < comm + (rspn + cmdn) * 4; a += 2) {
+            u16 *w = word(a) ;
+            if (!w) {
+                fatal(PE_HAT) ;
+                return ;
+            }
+            *w = 0 ;
+        }
+    }
+
+    sa = SA_S4 | (UDA50_MODEL << 4) | UDA50_VERSION ;
+    state = UQ_S4 ;
+    irq() ;
+}
+
+void UDA50::fatal(const u16 code) {
+    CLogger::Get()->Write("UDA50", LogError, "fatal error %o", code) ;
+    sa = SA_ER | code ;
+    state = UQ_FATAL ;
+    irq() ;
+}
+
+void UDA50::irq() {
+    const u16 vec = (s1 & SA_S1C_VEC) << 2 ;
+    if ((s1 & SA_S1C_IE) && vec && vec < 0400) {
+        cpu.interrupt(vec, 5) ;
+    }
+}
+
+void UDA50::reset() {
+    init() ;
+}
+
+// word points to the word at UNIBUS address a, 0 when there is no memory
+u16 *UDA50::word(const u32 a) {
+    const u32 aa = cpu.mmu.ub_decode(a & 0777776) ;
+    return aa < MEMSIZE ? cpu.unibus.core + (aa >> 1) : 0 ;
+}
+
+u16 *UDA50::span(const u32 a, u32 &wc) {
+    return word(a) ? cpu.unibus.ub_span(a & 0777776, wc) : 0 ;
+}
+
+// release gives descriptor idx of a ring back to the host. With F set the host
+// hears of it when the ring was full (commands) or empty (responses) before.
+void UDA50::release(const u32 ring, const u32 n, const u32 idx, u16 *hi, const int ioff) {
+    const bool f = *hi & DESC_F ;
+    *hi = (*hi & ~DESC_OWN) | DESC_F ;
+    if (!f) {
+        return ;
+    }
+
+    u16 *prev = word(ring + ((idx - 1) & (n - 1)) * 4 + 2) ;
+    if (n == 1 || (prev && (*prev & DESC_OWN))) {
+        u16 *w = word(comm + ioff) ;
+        if (w) {
+            *w = 1 ;
+        }
+        irq() ;
+    }
+}
+
+// take copies the next command out of the command ring, false when there is none
+bool UDA50::take(UDA50Slot &s) {
+    const u32 ring = comm + rspn * 4 ;
+    u16 *lo = word(ring + cmdidx * 4), *hi = word(ring + cmdidx * 4 + 2) ;
+    if (!lo || !hi) {
+        fatal(PE_HAT) ;
+        return false ;
+    }
+    if (!(*hi & DESC_OWN)) {
+        return false ;
+    }
+
+    const u32 p = (*lo | ((u32)(*hi & 077) << 16)) & 0777776 ;
+    u16 *len = word(p - 4), *ctc = word(p - 2) ;
+    if (!len || !ctc) {
+        fatal(PE_HAT) ;
+        return false ;
+    }
+
+    memset(s.cmd, 0, sizeof s.cmd) ;
+    const u32 n = (*len < sizeof s.cmd ? *len : sizeof s.cmd) / 2 ;
+    for (u32 i = 0; i < n; i++) {
+        u16 *w = word(p + i * 2) ;
+        if (!w) {
+            fatal(PE_HAT) ;
+            return false ;
+        }
+        s.cmd[i] = *w ;
+    }
+    const bool mscp = (*ctc >> 8) == 0 ; // connection 0, anything else (DUP) is dropped
+    if (!mscp) {
+        credits++ ; // the host spent a credit on it, the next end message returns it
+    }
+
+    release(ring, cmdn, cmdidx, hi, COMM_CI) ;
+    cmdidx = (cmdidx + 1) & (cmdn - 1) ;
+
+    s.state = mscp ? SLOT_CMD : SLOT_FREE ;
+    s.seq = seq++ ;
+    return true ;
+}
+
+// put hands the end message of s to the host, false while the response ring is full
+bool UDA50::put(UDA50Slot &s) {
+    u16 *lo = word(comm + rspidx * 4), *hi = word(comm + rspidx * 4 + 2) ;
+    if (!lo || !hi) {
+        fatal(PE_HAT) ;
+        return false ;
+    }
+    if (!(*hi & DESC_OWN)) {
+        return false ;
+    }
+
+    const u32 p = (*lo | ((u32)(*hi & 077) << 16)) & 0777776 ;
+    u16 *len = word(p - 4), *ctc = word(p - 2) ;
+    if (!len || !ctc) {
+        fatal(PE_HAT) ;
+        return false ;
+    }
+
+    const u8 cr = credits > 14 ? 14 : credits ;
+    credits -= cr ;
+    *len = s.rsplen ;
+    *ctc = cr + 1 ; // sequential message on connection 0, with the credits
+    for (u32 i = 0; i < s.rsplen / 2u; i++) {
+        u16 *w = word(p + i * 2) ;
+        if (!w) {
+            fatal(PE_HAT) ;
+            return false ;
+        }
+        *w = s.rsp[i] ;
+    }
+
+    release(comm, rspn, rspidx, hi, COMM_RI) ;
+    rspidx = (rspidx + 1) & (rspn - 1) ;
+    return true ;
+}
+
+// end starts the end message of s, len bytes long
+void UDA50::end(UDA50Slot &s, const u16 status, const u8 len) {
+    memset(s.rsp, 0, sizeof s.rsp) ;
+    s.rsp[M_CRF] = s.cmd[M_CRF] ;
+    s.rsp[M_CRF + 1] = s.cmd[M_CRF + 1] ;
+    s.rsp[M_UNIT] = s.cmd[M_UNIT] ;
+    s.rsp[M_OPC] = (s.cmd[M_OPC] & 0377) | OP_END ;
+    s.rsp[M_MOD] = status ;
+    s.rsplen = len ;
+    s.state = SLOT_END ;
+}
+
+// unitinfo fills in the unit part of an ONLINE, SET UNIT CHARACTERISTICS or GET UNIT STATUS end message
+void UDA50::unitinfo(UDA50Slot &s, const u16 u, const bool gus) {
+    const RAGeometry &g = ratypes[units[u].type] ;
+
+    s.rsp[10] = u ;                   // unit identifier
+    s.rsp[13] = (2 << 8) | g.mod ;    // disk class, model
+    s.rsp[14] = g.med & 0177777 ;     // media type
+    s.rsp[15] = g.med >> 16 ;
+    if (gus) {
+        s.rsp[18] = g.sect ;          // track size
+        s.rsp[19] = g.tpg ;           // group size
+        s.rsp[20] = g.gpc ;           // cylinder size
+        s.rsp[22] = g.rcts ;
+        s.rsp[23] = g.rbns | (g.rctc << 8) ;
+    } else {
+        s.rsp[18] = g.lbn & 0177777 ; // unit size
+        s.rsp[19] = g.lbn >> 16 ;
+        s.rsp[20] = u + 1 ;           // volume serial number
+    }
+}
+
+void UDA50::command(UDA50Slot &s) {
+    const u8 op = s.cmd[M_OPC] & 0377 ;
+    u16 u = s.cmd[M_UNIT] ;
+    const bool there = u < UDA50_UNITS && units[u].type != RA_NONE ;
+
+    switch (op) {
+        case OP_ABO:
+        case OP_GCS:
+            // nothing is ever found to abort, commands run to their end anyway
+            end(s, ST_SUC, op == OP_ABO ? 16 : 20) ;
+            s.rsp[6] = s.cmd[6] ; // outstanding reference number
+            s.rsp[7] = s.cmd[7] ;
+            break ;
+
+        case OP_SCC:
+            end(s, ST_SUC, 32) ;
+            s.rsp[8] = 120 ;          // controller timeout
+            s.rsp[9] = UDA50_VERSION ;
+            s.rsp[10] = 1 ;           // controller identifier
+            s.rsp[13] = (1 << 8) | 2 ; // mass storage controller, UDA50
+            break ;
+
+        case OP_GUS:
+            if (s.cmd[M_MOD] & MD_NXU) {
+                while (u < UDA50_UNITS && units[u].type == RA_NONE) {
+                    u++ ;
+                }
+            }
+            if (u >= UDA50_UNITS || units[u].type == RA_NONE) {
+                end(s, ST_OFL, 48) ;
+                if (s.cmd[M_MOD] & MD_NXU) {
+                    s.rsp[M_UNIT] = 0 ;
+                }
+                break ;
+            }
+            end(s, units[u].online ? ST_SUC : ST_AVL, 48) ;
+            s.rsp[M_UNIT] = u ;
+            unitinfo(s, u, true) ;
+            break ;
+
+        case OP_ONL:
+        case OP_SUC:
+            if (!there) {
+                end(s, ST_OFL, 44) ;
+                break ;
+            }
+            if (op == OP_ONL) {
+                end(s, units[u].online ? ST_SUC | SB_SUC_ON : ST_SUC, 44) ;
+                units[u].online = true ;
+            } else {
+                end(s, units[u].online ? ST_SUC : ST_AVL, 44) ;
+            }
+            unitinfo(s, u, false) ;
+            break ;
+
+        case OP_AVL:
+        case OP_DAP:
+        case OP_FLU:
+        case OP_REP:
+            if (!there) {
+                end(s, ST_OFL, 12) ;
+                break ;
+            }
+            if (op == OP_AVL) {
+                units[u].online = false ;
+            }
+            end(s, ST_SUC, 12) ; // the image goes back to the card by its sync policy
+            break ;
+
+        case OP_ACC:
+        case OP_CMP:
+        case OP_ERS:
+        case OP_RD:
+        case OP_WR: {
+                if (!there) {
+                    end(s, ST_OFL, 32) ;
+                    break ;
+                }
+                if (!units[u].online) {
+                    end(s, ST_AVL, 32) ;
+                    break ;
+                }
+
+                const u32 bc = s.cmd[M_BCNT] | ((u32) s.cmd[M_BCNT + 1] << 16) ;
+                const u32 ba = (s.cmd[M_BUFF] | ((u32) s.cmd[M_BUFF + 1] << 16)) & 0777777 ;
+                const u32 lbn = s.cmd[M_LBN] | ((u32) s.cmd[M_LBN + 1] << 16) ;
+                const u32 lbns = ratypes[units[u].type].lbn ;
+                const bool data = op == OP_RD || op == OP_WR || op == OP_CMP ; // with a host buffer
+
+                if (data && (ba & 1)) {
+                    end(s, ST_HST | SB_HST_OA, 32) ;
+                } else if (data && (bc & 1)) {
+                    end(s, ST_HST | SB_HST_OC, 32) ;
+                } else if (lbn >= lbns) {
+                    end(s, ST_ICM | I_LBN, 32) ;
+                } else if ((bc + RA_BLOCK - 1) / RA_BLOCK > lbns - lbn) {
+                    end(s, ST_ICM | I_BCNT, 32) ;
+                } else {
+                    s.status = ST_SUC ;
+                    s.addr = ba ;
+                    s.pos = lbn * RA_BLOCK ;
+                    s.left = op == OP_ERS ? (bc + RA_BLOCK - 1) / RA_BLOCK * RA_BLOCK : bc ;
+                    s.moved = op == OP_ERS ? bc : 0 ;
+                    s.due = 0 ;
+                    s.held = 0 ;
+                    s.state = SLOT_XFER ;
+                }
+            }
+            break ;
+
+        default:
+            end(s, ST_ICM | I_OPCD, 12) ;
+            break ;
+    }
+}
+
+// post sends the transfer nearest to where its heads are to the I/O engine
+void UDA50::post() {
+    UDA50Slot *s = 0 ;
+    u32 best = 0 ;
+    for (u8 i = 0; i < UDA50_SLOTS; i++) {
+        UDA50Slot &c = slots[i] ;
+        if (c.state != SLOT_XFER || !c.left || (verify(c) && (c.iowait || c.held))) {
+            continue ; // a COMPARE or ACCESS has one block out at a time
+        }
+        const u32 b = c.pos / RA_BLOCK, h = units[c.cmd[M_UNIT]].head ;
+        const u32 d = b > h ? b - h : h - b ;
+        if (!s || d < best || (d == best && c.seq < s->seq)) {
+            s = &c ;
+            best = d ;
+        }
+    }
+    if (!s) {
+        return ;
+    }
+
+    const u8 op = s->cmd[M_OPC] & 0377 ;
+    RAUnit &un = units[s->cmd[M_UNIT]] ;
+    const u32 from = s->pos ;
+
+    IORequest r = {&un.image, 0, 0, 0, op == OP_RD || verify(*s) ? IO_READ : IO_WRITE, EV_UDA, true, (u8)(s - slots)} ;
+    if (verify(*s) && cpu.io.room()) {
+        r.pos = s->pos ;
+        r.buf = s->block ;
+        r.len = s->left < RA_BLOCK ? s->left : RA_BLOCK ;
+        cpu.io.post(r) ;
+        s->iowait++ ;
+        s->held = r.len ;
+        s->pos += r.len ;
+        s->left -= r.len ;
+    }
+    while (!verify(*s) && s->left && cpu.io.room() > 1) { // leave one for the zero fill
+        r.pos = s->pos ;
+        if (op == OP_ERS) {
+            r.buf = zero ;
+            r.len = RA_BLOCK ;
+        } else {
+            u32 k = s->left / 2 ;
+            r.buf = span(s->addr, k) ;
+            if (!r.buf) {
+                s->status = ST_HST | SB_HST_NXM ;
+                s->left = 0 ;
+                break ;
+            }
+            r.len = k * 2 ;
+            s->addr = (s->addr + r.len) & 0777777 ;
+            s->moved += r.len ;
+        }
+        cpu.io.post(r) ;
+        s->iowait++ ;
+        s->pos += r.len ;
+        s->left -= r.len ;
+
+        if (!s->left && op == OP_WR && (s->pos % RA_BLOCK)) { // short write, fill the block with zeros
+            r.pos = s->pos ;
+            r.buf = zero ;
+            r.len = RA_BLOCK - s->pos % RA_BLOCK ;
+            cpu.io.post(r) ;
+            s->iowait++ ;
+        }
+    }
+
+    if (IOEngine::latency && s->pos != from) {
+        const RAGeometry &g = ratypes[un.type] ;
+        const u32 b = from / RA_BLOCK, c = b / (g.sect * g.surf), hc = un.head / (g.sect * g.surf) ;
+        s->due = IOEngine::due(RA81_TIMING, c > hc ? c - hc : hc - c, b % g.sect,
+            (s->pos - from + RA_BLOCK - 1) / RA_BLOCK) ;
+    }
+    un.head = s->pos / RA_BLOCK ;
+}
+
+// check takes the block a COMPARE or ACCESS has read, COMPARE holds it against host memory
+void UDA50::check(UDA50Slot &s) {
+    const u32 n = s.held ;
+    s.held = 0 ;
+    if (s.status != ST_SUC) { // the read failed
+        s.left = 0 ;
+        return ;
+    }
+    if ((s.cmd[M_OPC] & 0377) == OP_ACC) {
+        s.moved += n ;
+        return ;
+    }
+
+    for (u32 off = 0; off < n; ) {
+        u32 k = (n - off) / 2 ;
+        const u16 *h = span(s.addr, k) ;
+        if (!h) {
+            s.status = ST_HST | SB_HST_NXM ;
+            s.left = 0 ;
+            return ;
+        }
+        if (memcmp(h, s.block + off / 2, k * 2) != 0) {
+            s.status = ST_CMP ;
+            s.left = 0 ;
+            return ;
+        }
+        s.addr = (s.addr + k * 2) & 0777777 ;
+        s.moved += k * 2 ;
+        off += k * 2 ;
+    }
+}
+
+void UDA50::finish(UDA50Slot &s) {
+    const u16 status = s.status ;
+    const u32 moved = s.moved ;
+    end(s, status, 32) ;
+    s.rsp[M_BCNT] = moved & 0177777 ; // bytes transferred
+    s.rsp[M_BCNT + 1] = moved >> 16 ;
+}
+
+bool UDA50::busy() {
+    if (state != UQ_RUN) {
+        return false ;
+    }
+    if (polling) {
+        return true ;
+    }
+    for (u8 i = 0; i < UDA50_SLOTS; i++) {
+        if (slots[i].state != SLOT_FREE) {
+            return true ;
+        }
+    }
+    return false ;
+}
+
+void UDA50::step() {
+    if (state != UQ_RUN) {
+        return ;
+    }
+
+    // take what the command ring holds while there is room
+    for (u8 i = 0; i < UDA50_SLOTS && polling; i++) {
+        UDA50Slot &s = slots[i] ;
+        if (s.state != SLOT_FREE || s.iowait) {
+            continue ;
+        }
+        if (!take(s)) {
+            polling = false ;
+        } else if (s.state == SLOT_CMD) {
+            command(s) ;
+        }
+        if (state != UQ_RUN) {
+            return ;
+        }
+    }
+
+    post() ;
+
+    const u64 now = CTimer::GetClockTicks64() ;
+    for (u8 i = 0; i < UDA50_SLOTS; i++) {
+        UDA50Slot &s = slots[i] ;
+        if (s.state == SLOT_XFER && s.held && !s.iowait) {
+            check(s) ;
+        }
+        if (s.state == SLOT_XFER && !s.left && !s.held && !s.iowait && (!s.due || now >= s.due)) {
+            finish(s) ;
+        }
+        if (s.state == SLOT_END) {
+            if (!put(s)) {
+                if (state != UQ_RUN) {
+                    return ;
+                }
+                continue ; // response ring full, try again next step
+            }
+            s.state = SLOT_FREE ;
+            credits++ ;
+            polling = true ; // a slot is free, there may be more waiting
+        }
+    }
+}
+
+void UDA50::iodone(const u8 tag, const bool ok) {
+    UDA50Slot &s = slots[tag] ;
+    s.iowait-- ;
+    if (!ok) {
+        s.status = ST_DRV ; // transfer ran off the end of the image
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <circle/types.h>
+#include "disk.h"
+#include "xx11.h"
+
+#define UDA50_IP 017772150
+#define UDA50_SA 017772152
+
+#define UDA50_UNITS 4
+#define UDA50_SLOTS 8  // commands in flight
+#define UDA50_WORDS 32 // message text a slot holds, the longest end message is 48 bytes
+#define UDA50_BLOCK 256 // words of the block a COMPARE or ACCESS reads at a time
+
+// MSCP drive types
+enum RATYPE : u8 {
+    RD54,
+    RA81,
+    RA82,
+    RA92,
+    RA_NONE
+} ;
+
+struct RAUnit {
+    RATYPE type ;
+    DiskImage image ;
+    bool online ;
+    u32 head ; // the block under the heads
+} ;
+
+struct UDA50Slot {
+    u8 state ;
+    u32 seq ;                // order the commands were taken in
+    u16 cmd[UDA50_WORDS] ;
+    u16 rsp[UDA50_WORDS] ;
+    u8 rsplen ;              // bytes of rsp
+    u16 status ;
+    u32 addr, pos, left ;    // where a transfer goes on, bytes still to post
+    u32 moved ;              // bytes posted, or checked by a COMPARE or ACCESS
+    u8 iowait ;
+    u64 due ;
+    u32 held ;               // bytes read into block, still to be checked
+    u16 block[UDA50_BLOCK] ;
+} ;
+
+/*
+ * UDA50 MSCP disk controller. The host and the port talk through a command
+ * and a response ring in host memory, a read of IP tells the port to look at
+ * the command ring. Up to UDA50_SLOTS commands are taken at once; transfers go
+ * to the I/O engine nearest block first and every command is answered the
+ * moment it is through, so the end messages come back out of order.
+ * COMPARE and ACCESS read a block at a time into the slot, COMPARE holds it
+ * against host memory before the next one is read.
+ */
+class UDA50 : public XX11 {
+    public:
+        UDA50() ;
+
+        virtual u16 read16(u32 a) ;
+        virtual void write16(u32 a, u16 v) ;
+        void reset() ;
+        void step() ;
+        bool busy() ;
+        void iodone(const u8 tag, const bool ok) ;
+
+        // size is the image size of drive type t, name its file extension
+        static u32 size(const RATYPE t) ;
+        static const char *name(const RATYPE t) ;
+
+        RAUnit units[UDA50_UNITS] ;
+    private:
+        u8 state ;          // initialization step, or running
+        u16 sa ;
+        u16 s1 ;            // what the host wrote in step 1: ring sizes, IE and vector
+        u32 comm ;          // communications area, the response ring starts there
+        u32 cmdn, rspn ;    // ring entries
+        u32 cmdidx, rspidx ;
+        bool polling ;      // commands may be waiting in the ring
+        u8 credits ;        // to hand back to the host
+        u32 seq ;
+
+        UDA50Slot slots[UDA50_SLOTS] ;
+
+        void init() ;
+        void rings() ;
+        void fatal(const u16 code) ;
+        void irq() ;
+        u16 *word(const u32 a) ;
+        u16 *span(const u32 a, u32 &wc) ;
+        bool take(UDA50Slot &s) ;
+        bool put(UDA50Slot &s) ;
+        void release(const u32 ring, const u32 n, const u32 idx, u16 *hi, const int ioff) ;
+        void command(UDA50Slot &s) ;
+        void end(UDA50Slot &s, const u16 status, const u8 len) ;
+        void unitinfo(UDA50Slot &s, const u16 u, const bool gus) ;
+        void post() ;
+        void check(UDA50Slot &s) ;
+        void finish(UDA50Slot &s) ;
+} ;
@@ -68,6 +68,14 @@ void UNIBUS::init() {
     PUT_TBL(TC11_BA, &tc11) ;
     PUT_TBL(TC11_DT, &tc11) ;
 
+    // RH70 MASSBUS controller
+    for (u32 a = RH70_CS1; a <= RH70_CS3; a += 2) {
+        PUT_TBL(a, &rh70) ;
+    }
+
+    PUT_TBL(UDA50_IP, &uda50) ;
+    PUT_TBL(UDA50_SA, &uda50) ;
+
     PUT_TBL(RK11_CSR, &rk11) ;
     PUT_TBL(017777402, &rk11) ;
     PUT_TBL(017777404, &rk11) ;
@@ -86,6 +94,11 @@ void UNIBUS::init() {
     PUT_TBL(017776504, &dl11) ;
     PUT_TBL(017776506, &dl11) ;
 
+    PUT_TBL(DZ11_CSR, &dz11) ;
+    PUT_TBL(DZ11_RBUF, &dz11) ;
+    PUT_TBL(DZ11_TCR, &dz11) ;
+    PUT_TBL(DZ11_MSR, &dz11) ;
+
     PUT_TBL(KL11_XCSR, &cons) ;
     PUT_TBL(KL11_XBUF, &cons) ;
     PUT_TBL(KL11_RCSR, &cons) ;
@@ -171,6 +184,49 @@ u16 UNIBUS::ub_read16(const u32 a) {
     while (1) {}
 }
 
+/*
+ * ub_span hands DMA a run of core starting at UNIBUS address a. The run is cut
+ * at the next 8 KB boundary, where a UNIBUS map register (and every 64 KB
+ * address extension step) may send the transfer somewhere else, wc is
+ * trimmed to the words that fit.
+ */
+u16 *UNIBUS::ub_span(const u32 a, u32 &wc) {
+    u32 aa = cpu.mmu.ub_decode(a) & ~1u ;
+
+    if (aa < MEMSIZE) {
+        u32 n = (020000 - (a & 017776)) >> 1 ;
+        if (n > (MEMSIZE - aa) >> 1) {
+            n = (MEMSIZE - aa) >> 1 ;
+        }
+        if (wc > n) {
+            wc = n ;
+        }
+        return core + (aa >> 1) ;
+    }
+
+    CLogger::Get()->Write("UNIBUS", LogError, "ub_span non-existent address %08o", aa) ;
+    while (1) {}
+}
+
+/*
+ * mb_span is ub_span for the RH70, which masters the memory bus of the 11/70
+ * and reaches core by the 22 bit address a without the UNIBUS map. Only the
+ * end of memory cuts the run, past it mb_span returns 0.
+ */
+u16 *UNIBUS::mb_span(const u32 a, u32 &wc) {
+    const u32 aa = a & 017777776 ;
+
+    if (aa >= MEMSIZE) {
+        return 0 ;
+    }
+
+    const u32 n = (MEMSIZE - aa) >> 1 ;
+    if (wc > n) {
+        wc = n ;
+    }
+    return core + (aa >> 1) ;
+}
+
 u16 UNIBUS::read16(const u32 a) {
     if (a & 1) {
         cpu.errorRegister = 0100 ;
@@ -195,9 +251,12 @@ u16 UNIBUS::read16(const u32 a) {
 void UNIBUS::reset(bool i2c) {
     cons.clearterminal();
     dl11.clearterminal();
+    dz11.reset() ;
     rk11.reset();
     rl11.reset();
     tc11.reset() ;
+    rh70.reset() ;
+    uda50.reset() ;
     kw11.reset() ;
     if (i2c) {
         ptr_ptp.reset() ;
@@ -5,8 +5,11 @@
 #include "pc11.h"
 #include "lp11.h"
 #include "rl11.h"
+#include "rh70.h"
 #include "dl11.h"
+#include "dz11.h"
 #include "tc11.h"
+#include "uda50.h"
 #include "vt11.h"
 #include "xx11.h"
 #include "toy.h"
@@ -25,6 +28,8 @@ class UNIBUS : public XX11 {
         void ub_write16(u32 a, u16 v) ;
         virtual u16 read16(const u32 a) ;
         u16 ub_read16(u32 a) ;
+        u16 *ub_span(const u32 a, u32 &wc) ;
+        u16 *mb_span(const u32 a, u32 &wc) ;
         void reset(bool i2c = true) ;
 
         KL11 cons;
@@ -34,7 +39,10 @@ class UNIBUS : public XX11 {
         LP11 lp11;
         RL11 rl11;
         DL11 dl11;
+        DZ11 dz11 ;
         TC11 tc11 ;
+        RH70 rh70 ;
+        UDA50 uda50 ;
         VT11 vt11 ;
         TOY  toy ;
         u16 *core ;
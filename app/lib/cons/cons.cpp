@@ -1,15 +1,23 @@
 #include <cons/cons.h>
+#include <cons/vtscreen.h>
 #include <circle/string.h>
 #include <circle/util.h>
 #include <circle/logger.h>
 #include <circle/serial.h>
 
+#ifndef ARM_ALLOW_MULTI_CORE
+#define ARM_ALLOW_MULTI_CORE
+#endif
+
+#include <circle/multicore.h>
+
 Console *Console::pthis = 0 ;
 
 extern CSerialDevice *pSerial ;
 
 Console::Console() :
-    shutdownMode(ShutdownNone)
+    shutdownMode(ShutdownNone),
+    sender(0)
 {
     pthis = this ;
 }
@@ -22,7 +30,23 @@ void Console::init() {
 }
 
 bool Console::sendChar(const char c) {
-    return pSerial->Write(&c, 1) == 1 ;
+    // the terminal rings take one producer, only the emulator core writes to them,
+    // what the other cores send goes straight to the serial port
+    const bool own = CMultiCoreSupport::ThisCore() == CONS_CORE ;
+    VTScreen *vt = own ? VTScreen::get() : 0 ;
+    if (vt && !vt->room()) {
+        return false ;
+    }
+
+    const bool sent = (sender && own) ? (*sender)(c) : pSerial->Write(&c, 1) == 1 ;
+    if (sent && vt) {
+        vt->put(c) ; // the ODT shows on the screen terminal too
+    }
+    return sent ;
+}
+
+void Console::redirect(TConsoleSender *pSender) {
+    sender = pSender ;
 }
 
 void Console::sendString(const char *str) {
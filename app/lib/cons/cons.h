@@ -5,9 +5,13 @@
 #include "shutdown.h"
 #include <util/queue.h>
 
+#define CONS_CORE 1 // the emulator core, the one producer of the terminal rings
+
 void gprintf(const char *__restrict format, ...) ;
 void iprintf(const char *__restrict format, ...) ;
 
+typedef bool TConsoleSender(const char c) ;
+
 class Console {
 	public:
 		Console();
@@ -19,10 +23,13 @@ class Console {
 		bool sendChar(const char c) ;
 		void sendString(const char *str) ;
 		void printf(const char *__restrict format, ...) ;
+		// redirect sends the output of the emulator core elsewhere than the serial port
+		void redirect(TConsoleSender *pSender) ;
 
 		static Console* get() ;
 	private:
 		static Console *pthis ;
+		TConsoleSender *sender ;
 }  ;
 
 #endif
@@ -0,0 +1,484 @@
+#include "vtscreen.h"
+
+#include <circle/logger.h>
+#include <circle/util.h>
+
+enum VTState : u8 {
+    VS_TEXT,
+    VS_ESC,  // after ESC
+    VS_CSI,  // in ESC [ parameters
+    VS_SKIP, // the character after ESC ( ) or #
+    VS_ROW,  // VT52 ESC Y, the row comes next
+    VS_COL   // and then the column
+} ;
+
+#define VT_NORMAL WHITE_COLOR
+#define VT_BRIGHT BRIGHT_WHITE_COLOR
+
+VTScreen *VTScreen::pthis = 0 ;
+
+VTScreen::VTScreen(const bool bVT52)
+:   fb(0),
+    buffer(0),
+    pitch(0),
+    changed(true),
+    top(0),
+    shown(0),
+    crow(0),
+    ccol(0),
+    vt52(bVT52)
+{
+    reset() ;
+}
+
+VTScreen::~VTScreen(void) {
+    pthis = 0 ;
+    delete fb ;
+    fb = 0 ;
+}
+
+VTScreen *VTScreen::get() {
+    return pthis ;
+}
+
+bool VTScreen::Initialize(void) {
+    const unsigned w = VT_COLS * font.GetCharWidth() ;
+    const unsigned h = VT_ROWS * font.GetCharHeight() ;
+
+    // the firmware scales the text area to the display, the lower half is the scroll room
+    fb = new CBcmFrameBuffer(w, h, DEPTH, w, 2 * h) ;
+#if DEPTH == 8
+    fb->SetPalette(VT_NORMAL, WHITE_COLOR16) ;
+    fb->SetPalette(VT_BRIGHT, BRIGHT_WHITE_COLOR16) ;
+#endif
+    if (!fb->Initialize() || fb->GetDepth() != DEPTH || fb->GetVirtHeight() < 2 * h) {
+        CLogger::Get()->Write("vtscreen", LogError, "Cannot set up a %ux%u frame buffer", w, 2 * h) ;
+        return false ;
+    }
+
+    buffer = (TScreenColor *) (uintptr) fb->GetBuffer() ;
+    pitch = fb->GetPitch() / sizeof(TScreenColor) ;
+    memset(buffer, 0, fb->GetSize()) ;
+    fb->SetVirtualOffset(0, 0) ;
+
+    pthis = this ;
+    return true ;
+}
+
+void VTScreen::reset() {
+    for (u8 r = 0; r < VT_ROWS; r++) {
+        for (u8 c = 0; c < VT_COLS; c++) {
+            cells[r][c].c = ' ' ;
+            cells[r][c].attr = 0 ;
+            dirty[r][c] = true ;
+        }
+    }
+    changed = true ;
+    state = VS_TEXT ;
+    row = col = 0 ;
+    wrap = false ;
+    attr = 0 ;
+    mtop = 0 ;
+    mbottom = VT_ROWS - 1 ;
+    srow = scol = sattr = 0 ;
+    yrow = 0 ;
+    nparams = 0 ;
+    priv = false ;
+}
+
+void VTScreen::update(void) {
+    u8 c ;
+    while (in.get(c)) {
+        c &= 0177 ;
+        if (c < 040 && state != VS_ROW && state != VS_COL) {
+            control(c) ;
+            continue ;
+        }
+
+        switch (state) {
+            case VS_TEXT:
+                print(c) ;
+                break ;
+            case VS_ESC:
+                state = VS_TEXT ;
+                escape(c) ;
+                break ;
+            case VS_CSI:
+                sequence(c) ;
+                break ;
+            case VS_SKIP:
+                state = VS_TEXT ;
+                break ;
+            case VS_ROW:
+                yrow = c - 040 ;
+                state = VS_COL ;
+                break ;
+            case VS_COL:
+                state = VS_TEXT ;
+                move(yrow, c - 040) ;
+                break ;
+        }
+    }
+
+    // the cursor follows its cell when the screen moves under it
+    const u8 p = (top + row) % VT_ROWS ;
+    if (p != crow || col != ccol) {
+        dirty[crow][ccol] = true ;
+        dirty[p][col] = true ;
+        crow = p ;
+        ccol = col ;
+        changed = true ;
+    }
+
+    if (!changed) {
+        return ;
+    }
+    changed = false ;
+
+    for (u8 r = 0; r < VT_ROWS; r++) {
+        for (u8 c = 0; c < VT_COLS; c++) {
+            if (dirty[r][c]) {
+                dirty[r][c] = false ;
+                draw(r, c, r == crow && c == ccol) ;
+            }
+        }
+    }
+
+    // the rows are in place before the screen moves to them
+    if (shown != top) {
+        shown = top ;
+        fb->SetVirtualOffset(0, shown * font.GetCharHeight()) ;
+    }
+}
+
+// draw puts a cell into both halves of the frame buffer
+void VTScreen::draw(const u8 p, const u8 c, const bool cursor) {
+    const VTCell &v = cells[p][c] ;
+    const char ch = v.c ;
+    const bool inverse = ((v.attr & VT_REVERSE) != 0) != cursor ;
+    const TScreenColor on = (v.attr & VT_BOLD) ? VT_BRIGHT : VT_NORMAL ;
+    const TScreenColor fg = inverse ? BLACK_COLOR : on ;
+    const TScreenColor bg = inverse ? on : BLACK_COLOR ;
+
+    const unsigned w = font.GetCharWidth() ;
+    const unsigned h = font.GetCharHeight() ;
+    for (unsigned y = 0; y < h; y++) {
+        const bool line = (v.attr & VT_UNDERLINE) && y == font.GetUnderline() ;
+        TScreenColor *p0 = buffer + (p * h + y) * pitch + c * w ;
+        TScreenColor *p1 = p0 + VT_ROWS * h * pitch ;
+        for (unsigned x = 0; x < w; x++) {
+            p0[x] = p1[x] = line || font.GetPixel(ch, x, y) ? fg : bg ;
+        }
+    }
+}
+
+void VTScreen::control(const u8 c) {
+    switch (c) {
+        case 010:
+            if (col > 0) {
+                col-- ;
+            }
+            wrap = false ;
+            break ;
+        case 011:
+            col = (col | 7) + 1 < VT_COLS ? (col | 7) + 1 : VT_COLS - 1 ;
+            wrap = false ;
+            break ;
+        case 012:
+        case 013:
+        case 014:
+            linefeed() ;
+            break ;
+        case 015:
+            col = 0 ;
+            wrap = false ;
+            break ;
+        case 030:
+        case 032:
+            state = VS_TEXT ;
+            break ;
+        case 033:
+            state = VS_ESC ;
+            break ;
+    }
+}
+
+void VTScreen::escape(const u8 c) {
+    if (vt52) {
+        switch (c) {
+            case 'A':
+                move(row - 1, col) ;
+                break ;
+            case 'B':
+                move(row + 1, col) ;
+                break ;
+            case 'C':
+                move(row, col + 1) ;
+                break ;
+            case 'D':
+                move(row, col - 1) ;
+                break ;
+            case 'H':
+                move(0, 0) ;
+                break ;
+            case 'I':
+                reverse() ;
+                break ;
+            case 'J':
+                erase(row, col, VT_COLS) ;
+                for (u8 r = row + 1; r < VT_ROWS; r++) {
+                    erase(r, 0, VT_COLS) ;
+                }
+                break ;
+            case 'K':
+                erase(row, col, VT_COLS) ;
+                break ;
+            case 'Y':
+                state = VS_ROW ;
+                break ;
+            case '<':
+                vt52 = false ;
+                break ;
+        }
+        return ;
+    }
+
+    switch (c) {
+        case '[':
+            state = VS_CSI ;
+            nparams = 0 ;
+            params[0] = 0 ;
+            priv = false ;
+            break ;
+        case 'D':
+            linefeed() ;
+            break ;
+        case 'E':
+            col = 0 ;
+            linefeed() ;
+            break ;
+        case 'M':
+            reverse() ;
+            break ;
+        case '7':
+            srow = row ;
+            scol = col ;
+            sattr = attr ;
+            break ;
+        case '8':
+            attr = sattr ;
+            move(srow, scol) ;
+            break ;
+        case 'c':
+            reset() ;
+            break ;
+        case '(':
+        case ')':
+        case '#':
+            state = VS_SKIP ;
+            break ;
+    }
+}
+
+void VTScreen::sequence(const u8 c) {
+    if (c >= '0' && c <= '9') {
+        if (!nparams) {
+            nparams = 1 ;
+        }
+        u16 &v = params[nparams - 1] ;
+        v = v < 1000 ? v * 10 + (c - '0') : v ;
+        return ;
+    }
+    if (c == ';') {
+        if (!nparams) {
+            nparams = 1 ;
+        }
+        if (nparams < VT_PARAMS) {
+            params[nparams++] = 0 ;
+        }
+        return ;
+    }
+    if (c == '?') {
+        priv = true ;
+        return ;
+    }
+    if (c < 0100) {
+        return ; // intermediate characters are not used
+    }
+
+    state = VS_TEXT ;
+    switch (c) {
+        case 'A': {
+                // inside the scrolling region the cursor stops at its margin
+                const int r = row - param(0, 1) ;
+                move(row >= mtop && r < mtop ? mtop : r, col) ;
+            }
+            break ;
+        case 'B': {
+                const int r = row + param(0, 1) ;
+                move(row <= mbottom && r > mbottom ? mbottom : r, col) ;
+            }
+            break ;
+        case 'C':
+            move(row, col + param(0, 1)) ;
+            break ;
+        case 'D':
+            move(row, col - param(0, 1)) ;
+            break ;
+        case 'H':
+        case 'f':
+            move(param(0, 1) - 1, param(1, 1) - 1) ;
+            break ;
+        case 'J':
+            switch (param(0, 0)) {
+                case 0:
+                    erase(row, col, VT_COLS) ;
+                    for (u8 r = row + 1; r < VT_ROWS; r++) {
+                        erase(r, 0, VT_COLS) ;
+                    }
+                    break ;
+                case 1:
+                    for (u8 r = 0; r < row; r++) {
+                        erase(r, 0, VT_COLS) ;
+                    }
+                    erase(row, 0, col + 1) ;
+                    break ;
+                case 2:
+                    for (u8 r = 0; r < VT_ROWS; r++) {
+                        erase(r, 0, VT_COLS) ;
+                    }
+                    break ;
+            }
+            break ;
+        case 'K':
+            switch (param(0, 0)) {
+                case 0:
+                    erase(row, col, VT_COLS) ;
+                    break ;
+                case 1:
+                    erase(row, 0, col + 1) ;
+                    break ;
+                case 2:
+                    erase(row, 0, VT_COLS) ;
+                    break ;
+            }
+            break ;
+        case 'm':
+            for (u8 i = 0; i < (nparams ? nparams : 1); i++) {
+                switch (nparams ? params[i] : 0) {
+                    case 0:
+                        attr = 0 ;
+                        break ;
+                    case 1:
+                        attr |= VT_BOLD ;
+                        break ;
+                    case 4:
+                        attr |= VT_UNDERLINE ;
+                        break ;
+                    case 7:
+                        attr |= VT_REVERSE ;
+                        break ;
+                }
+            }
+            break ;
+        case 'r': {
+                const u16 t = param(0, 1) - 1 ;
+                const u16 b = param(1, VT_ROWS) - 1 ;
+                if (t < b && b < VT_ROWS) {
+                    mtop = t ;
+                    mbottom = b ;
+                    move(0, 0) ;
+                }
+            }
+            break ;
+        case 'l':
+            if (priv && param(0, 0) == 2) {
+                vt52 = true ; // DECANM
+            }
+            break ;
+    }
+}
+
+void VTScreen::print(const u8 c) {
+    if (c == 0177) {
+        return ;
+    }
+    if (wrap) {
+        col = 0 ;
+        wrap = false ;
+        linefeed() ;
+    }
+
+    VTCell &v = cell(row, col) ;
+    v.c = c ;
+    v.attr = attr ;
+    touch(row, col) ;
+
+    if (col < VT_COLS - 1) {
+        col++ ;
+    } else {
+        wrap = true ;
+    }
+}
+
+void VTScreen::move(const int r, const int c) {
+    row = r < 0 ? 0 : (r >= VT_ROWS ? VT_ROWS - 1 : r) ;
+    col = c < 0 ? 0 : (c >= VT_COLS ? VT_COLS - 1 : c) ;
+    wrap = false ;
+}
+
+void VTScreen::linefeed() {
+    if (row == mbottom) {
+        scrollup() ;
+    } else if (row < VT_ROWS - 1) {
+        row++ ;
+    }
+}
+
+void VTScreen::reverse() {
+    if (row == mtop) {
+        scrolldown() ;
+    } else if (row > 0) {
+        row-- ;
+    }
+}
+
+// scrollup turns the whole screen by moving its top, a region has its cells copied
+void VTScreen::scrollup() {
+    if (mtop == 0 && mbottom == VT_ROWS - 1) {
+        top = (top + 1) % VT_ROWS ;
+    } else {
+        for (u8 r = mtop; r < mbottom; r++) {
+            for (u8 c = 0; c < VT_COLS; c++) {
+                cell(r, c) = cell(r + 1, c) ;
+                touch(r, c) ;
+            }
+        }
+    }
+    erase(mbottom, 0, VT_COLS) ;
+}
+
+void VTScreen::scrolldown() {
+    if (mtop == 0 && mbottom == VT_ROWS - 1) {
+        top = (top + VT_ROWS - 1) % VT_ROWS ;
+    } else {
+        for (u8 r = mbottom; r > mtop; r--) {
+            for (u8 c = 0; c < VT_COLS; c++) {
+                cell(r, c) = cell(r - 1, c) ;
+                touch(r, c) ;
+            }
+        }
+    }
+    erase(mtop, 0, VT_COLS) ;
+}
+
+void VTScreen::erase(const u8 r, const u8 from, const u8 to) {
+    for (u8 c = from; c < to; c++) {
+        VTCell &v = cell(r, c) ;
+        if (v.c != ' ' || v.attr) {
+            v.c = ' ' ;
+            v.attr = 0 ;
+            touch(r, c) ;
+        }
+    }
+}
@@ -0,0 +1,95 @@
+#ifndef _cons_vtscreen_h
+#define _cons_vtscreen_h
+
+#include <circle/types.h>
+#include <circle/bcmframebuffer.h>
+#include <circle/chargenerator.h>
+#include <circle/screen.h>
+#include <arm11/ring.h>
+
+#define VT_COLS 80
+#define VT_ROWS 24
+#define VT_RING 4096 // characters between the emulator core and the screen core
+#define VT_PARAMS 8  // numeric parameters of a control sequence
+
+// cell attributes
+#define VT_BOLD      01
+#define VT_UNDERLINE 02
+#define VT_REVERSE   04
+
+struct VTCell {
+	char c ;
+	u8 attr ;
+} ;
+
+/*
+ * VT100 terminal on the HDMI screen, VT52 mode included. What the console
+ * sends goes on a ring, the screen core interprets it into a cell buffer and
+ * draws the cells that changed. The frame buffer is twice the text height and
+ * every row is drawn in both halves, so scrolling the whole screen only moves
+ * the virtual offset of the frame buffer, one row per line.
+ */
+class VTScreen {
+	public:
+		VTScreen(const bool bVT52) ;
+		~VTScreen(void) ;
+
+		bool Initialize(void) ;
+
+		// producer side, on the emulator core
+		inline bool put(const u8 c) { return in.put(c) ; }
+		inline u32 room() { return in.room() ; }
+
+		// update interprets what came in and draws it, on the screen core
+		void update(void) ;
+
+		static VTScreen *get() ;
+	private:
+		static VTScreen *pthis ;
+
+		void control(const u8 c) ;
+		void escape(const u8 c) ;
+		void sequence(const u8 c) ;
+		void print(const u8 c) ;
+
+		void linefeed() ;
+		void reverse() ;
+		void scrollup() ;
+		void scrolldown() ;
+		void erase(const u8 r, const u8 from, const u8 to) ;
+		void move(const int r, const int c) ;
+		void reset() ;
+
+		inline VTCell &cell(const u8 r, const u8 c) { return cells[(top + r) % VT_ROWS][c] ; }
+		inline void touch(const u8 r, const u8 c) { dirty[(top + r) % VT_ROWS][c] = true ; changed = true ; }
+		inline u16 param(const u8 i, const u16 def) { return i < nparams && params[i] ? params[i] : def ; }
+
+		void draw(const u8 p, const u8 c, const bool cursor) ;
+
+		ByteRing<VT_RING> in ;
+		CBcmFrameBuffer *fb ;
+		CCharGenerator font ;
+		TScreenColor *buffer ;
+		u32 pitch ; // in pixels
+
+		VTCell cells[VT_ROWS][VT_COLS] ; // by frame buffer row, the screen starts at top
+		bool dirty[VT_ROWS][VT_COLS] ;
+		bool changed ;
+		u8 top ;           // cell row shown at the top of the screen
+		u8 shown ;         // top as the frame buffer offset has it
+		u8 crow, ccol ;    // where the cursor was drawn, by frame buffer row
+
+		u8 state ;
+		bool vt52 ;
+		u8 row, col ;
+		bool wrap ;        // the last column has been written, the next character goes to the next line
+		u8 attr ;
+		u8 mtop, mbottom ; // scrolling region
+		u8 srow, scol, sattr ; // saved by ESC 7
+		u8 yrow ;              // row of a VT52 ESC Y
+		u16 params[VT_PARAMS] ;
+		u8 nparams ;
+		bool priv ;        // a ? came after CSI
+} ;
+
+#endif
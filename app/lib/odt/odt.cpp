@@ -6,7 +6,6 @@
 #include <circle/serial.h>
 
 extern KB11 cpu ;
-extern CSerialDevice *pSerial ;
 void disasm(u16 ia);
 
 ODT::ODT() :
@@ -27,6 +26,7 @@ void ODT::loop() {
 
     if (!prompt_shown) {
         prompt_shown = true ;
+        cpu.unibus.cons.drain() ; // what the guest printed goes out before the prompt
         if (cpu.wtstate) {
             cons->printf("\r\nw %06o\r\n@", cpu.RR[7]) ;
         } else {
@@ -35,8 +35,7 @@ void ODT::loop() {
     }
 
     unsigned char c ;
-	int n = pSerial->Read(&c, 1) ;
-	if (n <= 0) {
+	if (!cpu.unibus.cons.hostget(c)) {
 		return ;
 	}
 
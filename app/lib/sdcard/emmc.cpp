@@ -44,6 +44,7 @@
 	#include <circle/bcmpropertytags.h>
 	#include <circle/synchronize.h>
 	#include <circle/machineinfo.h>
+	#include <circle/devicetreeblob.h>
 	#include <circle/memio.h>
 	#include <circle/sched/scheduler.h>
 #else
@@ -95,6 +96,13 @@
 // Required for QEMU
 #define EMMC_ALLOW_OLD_SDHCI
 
+// Move the data of read and write commands by ADMA2 instead of through the FIFO
+// Pi 4 EMMC2 only, off until it has been verified on hardware
+//#define EMMC_ADMA2
+#if RASPPI != 4
+	#undef EMMC_ADMA2
+#endif
+
 #if RASPPI != 4
 	#define EMMC_BASE	ARM_EMMC_BASE
 #else
@@ -120,6 +128,8 @@
 #define EMMC_CAPABILITIES_0	(EMMC_BASE + 0x40)
 #define EMMC_CAPABILITIES_1	(EMMC_BASE + 0x44)
 #define EMMC_FORCE_IRPT		(EMMC_BASE + 0x50)
+#define EMMC_ADMA_ERR		(EMMC_BASE + 0x54)
+#define EMMC_ADMA_ADDR		(EMMC_BASE + 0x58)
 #define EMMC_BOOT_TIMEOUT	(EMMC_BASE + 0x70)
 #define EMMC_DBG_SEL		(EMMC_BASE + 0x74)
 #define EMMC_EXRDFIFO_CFG	(EMMC_BASE + 0x80)
@@ -192,6 +202,102 @@
 #define SD_CARD_REMOVAL         (1 << 7)
 #define SD_CARD_INTERRUPT       (1 << 8)
 
+#ifdef EMMC_ADMA2
+
+#define SD_DMA_SELECT_MASK	(3 << 3)	// in CONTROL0
+#define SD_DMA_SELECT_ADMA2_32	(2 << 3)
+
+#define ADMA_VALID		(1 << 0)	// descriptor attributes
+#define ADMA_END		(1 << 1)
+#define ADMA_ACT_TRAN		(2 << 4)
+
+#define ADMA_CHUNK		0x8000		// bytes per descriptor
+#define ADMA_DESCS		128
+#define ADMA_MAX		(ADMA_CHUNK * ADMA_DESCS)
+
+#define ADMA_LIMIT		0x40000000	// buffers come from the low heap, below 1 GB
+
+static boolean s_bADMA = FALSE;
+static u32 s_nADMABusBase = 0;			// bus address of ARM address 0 as EMMC2 sees it
+static u32 s_nADMAWindow = 0;			// bytes from ARM address 0 that EMMC2 reaches
+static u32 s_ADMATable[ADMA_DESCS * 2] __attribute__ ((aligned (DATA_CACHE_LINE_LENGTH_MIN)));
+
+// FindADMAWindow takes the DMA window of EMMC2 from the emmc2bus dma-ranges, which the
+// firmware sets for the SoC stepping: B0 boards see RAM at bus 0xC0000000 and only its
+// first GB, later ones 1:1. Without the property ADMA is left off.
+static boolean FindADMAWindow (void)
+{
+	const CDeviceTreeBlob *pDTB = CMachineInfo::Get ()->GetDTB ();
+	if (!pDTB)
+	{
+		return FALSE;
+	}
+
+	const TDeviceTreeNode *pNode = pDTB->FindNode ("/emmc2bus");
+	if (!pNode)
+	{
+		return FALSE;
+	}
+
+	// <child address (2 cells) parent address (2 cells) size (1 cell)>
+	const TDeviceTreeProperty *pRanges = pDTB->FindProperty (pNode, "dma-ranges");
+	if (   !pRanges
+	    || pDTB->GetPropertyValueLength (pRanges) < 5 * sizeof (u32)
+	    || pDTB->GetPropertyValueWord (pRanges, 0) != 0
+	    || pDTB->GetPropertyValueWord (pRanges, 2) != 0
+	    || pDTB->GetPropertyValueWord (pRanges, 3) != 0)
+	{
+		return FALSE;
+	}
+
+	u64 nBus = pDTB->GetPropertyValueWord (pRanges, 1);
+	u64 nSize = pDTB->GetPropertyValueWord (pRanges, 4);
+	if (nBus + nSize > 0x100000000ULL)
+	{
+		nSize = 0x100000000ULL - nBus;
+	}
+
+	s_nADMABusBase = (u32) nBus;
+	s_nADMAWindow = (u32) (nSize < ADMA_LIMIT ? nSize : ADMA_LIMIT);
+
+	return s_nADMAWindow != 0;
+}
+
+// SetupADMA describes the buffer in 32-bit ADMA2 descriptors, it fails when the buffer
+// cannot be handed to the controller and the FIFO has to be used instead
+static boolean SetupADMA (void *pBuffer, size_t nLength)
+{
+	uintptr nAddress = (uintptr) pBuffer;
+	if (   !s_bADMA
+	    || (nAddress & (DATA_CACHE_LINE_LENGTH_MIN-1)) != 0
+	    || (nLength & (DATA_CACHE_LINE_LENGTH_MIN-1)) != 0
+	    || nLength > ADMA_MAX
+	    || nAddress + nLength > s_nADMAWindow
+	    || (uintptr) s_ADMATable + sizeof s_ADMATable > s_nADMAWindow)
+	{
+		return FALSE;
+	}
+
+	unsigned i = 0;
+	for (size_t nOffset = 0; nOffset < nLength; nOffset += ADMA_CHUNK, i++)
+	{
+		size_t nChunk = nLength - nOffset < ADMA_CHUNK ? nLength - nOffset : ADMA_CHUNK;
+		s_ADMATable[i*2] = ADMA_VALID | ADMA_ACT_TRAN | (nChunk << 16);
+		s_ADMATable[i*2+1] = s_nADMABusBase + (u32) (nAddress + nOffset);
+	}
+	s_ADMATable[i*2-2] |= ADMA_END;
+
+	CleanAndInvalidateDataCacheRange ((uintptr) s_ADMATable, sizeof s_ADMATable);
+	CleanAndInvalidateDataCacheRange (nAddress, nLength);
+
+	write32 (EMMC_ADMA_ADDR, s_nADMABusBase + (u32) (uintptr) s_ADMATable);
+	write32 (EMMC_CONTROL0, (read32 (EMMC_CONTROL0) & ~SD_DMA_SELECT_MASK) | SD_DMA_SELECT_ADMA2_32);
+
+	return TRUE;
+}
+
+#endif
+
 #endif
 
 #define SD_RESP_NONE        SD_CMD_RSPNS_TYPE_NONE
@@ -917,6 +1023,14 @@ void CEMMCDevice::IssueCommandInt (u32 cmd_reg, u32 argument, int timeout)
 	u32 blksizecnt = m_block_size | (m_blocks_to_transfer << 16);
 	write32 (EMMC_BLKSIZECNT, blksizecnt);
 
+#ifdef EMMC_ADMA2
+	if (   (cmd_reg & SD_CMD_ISDATA)
+	    && SetupADMA (m_buf, m_blocks_to_transfer * m_block_size))
+	{
+		cmd_reg |= SD_CMD_DMA;
+	}
+#endif
+
 	// Set argument 1 reg
 	write32 (EMMC_ARG1, argument);
 
@@ -962,8 +1076,8 @@ void CEMMCDevice::IssueCommandInt (u32 cmd_reg, u32 argument, int timeout)
 		break;
 	}
 
-	// If with data, wait for the appropriate interrupt
-	if (cmd_reg & SD_CMD_ISDATA)
+	// If with data and not by DMA, wait for the appropriate interrupt
+	if ((cmd_reg & (SD_CMD_ISDATA | SD_CMD_DMA)) == SD_CMD_ISDATA)
 	{
 		u32 wr_irpt;
 		int is_write = 0;
@@ -1054,6 +1168,13 @@ void CEMMCDevice::IssueCommandInt (u32 cmd_reg, u32 argument, int timeout)
 			{
 #ifdef EMMC_DEBUG
 				LogWrite (LogWarning, "Error occured whilst waiting for transfer complete interrupt");
+#endif
+#ifdef EMMC_ADMA2
+				if (irpts & (1 << (16 + SD_ERR_ADMA)))
+				{
+					LogWrite (LogWarning, "ADMA error %x at %08x", read32 (EMMC_ADMA_ERR), read32 (EMMC_ADMA_ADDR));
+					ResetDat ();
+				}
 #endif
 				m_last_error = irpts & 0xffff0000;
 				m_last_interrupt = irpts;
@@ -1065,6 +1186,14 @@ void CEMMCDevice::IssueCommandInt (u32 cmd_reg, u32 argument, int timeout)
 		}
 	}
 
+#ifdef EMMC_ADMA2
+	// Drop lines the CPU may have fetched while the controller was writing to memory
+	if ((cmd_reg & (SD_CMD_DMA | SD_CMD_DAT_DIR_CH)) == (SD_CMD_DMA | SD_CMD_DAT_DIR_CH))
+	{
+		CleanAndInvalidateDataCacheRange ((uintptr) m_buf, m_blocks_to_transfer * m_block_size);
+	}
+#endif
+
 	// Return success
 	m_last_cmd_success = 1;
 }
@@ -1186,6 +1315,14 @@ void CEMMCDevice::HandleInterrupts (void)
 		reset_mask |= SD_CARD_INTERRUPT;
 	}
 
+#ifdef EMMC_ADMA2
+	if (irpts & (1 << (16 + SD_ERR_ADMA)))
+	{
+		LogWrite (LogWarning, "ADMA error %x at %08x", read32 (EMMC_ADMA_ERR), read32 (EMMC_ADMA_ADDR));
+		ResetDat ();
+	}
+#endif
+
 	if (irpts & 0x8000)
 	{
 #ifdef EMMC_DEBUG2
@@ -2191,6 +2328,19 @@ int CEMMCDevice::CardInit (void)
 #endif
 	}
 
+#ifdef EMMC_ADMA2
+	s_bADMA = m_hci_ver >= 2 && (read32 (EMMC_CAPABILITIES_0) & (1 << 19));
+	if (s_bADMA && !FindADMAWindow ())
+	{
+		LogWrite (LogWarning, "No EMMC2 DMA window in the device tree, ADMA2 off");
+
+		s_bADMA = FALSE;
+	}
+#ifdef EMMC_DEBUG2
+	LogWrite (LogDebug, "ADMA2 %s, bus %08x", s_bADMA ? "supported" : "not supported", s_nADMABusBase);
+#endif
+#endif
+
 #endif	// #ifndef USE_SDHOST
 
 	// The SEND_SCR command may fail with a DATA_TIMEOUT on the Raspberry Pi 4
@@ -2309,6 +2459,21 @@ int CEMMCDevice::EnsureDataMode (void)
 
 int CEMMCDevice::DoDataCommand (int is_write, u8 *buf, size_t buf_size, u32 block_no)
 {
+#ifdef EMMC_ADMA2
+	// Longer transfers than one descriptor table holds go in several commands
+	while (buf_size > ADMA_MAX)
+	{
+		if (DoDataCommand (is_write, buf, ADMA_MAX, block_no) < 0)
+		{
+			return -1;
+		}
+
+		buf += ADMA_MAX;
+		buf_size -= ADMA_MAX;
+		block_no += ADMA_MAX / SD_BLOCK_SIZE;
+	}
+#endif
+
 	// PLSS table 4.20 - SDSC cards use byte addresses rather than block addresses
 	if (!m_card_supports_sdhc)
 	{
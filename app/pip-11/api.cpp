@@ -5,7 +5,7 @@
 
 extern KB11 cpu ;
 static const u16 API_PORT = 5366 ;
-extern volatile bool kb11hrottle ;
+extern volatile u8 kb11speed ;
 
 API::API(CNetSubSystem *pNet)
 :   pnet(pNet),
@@ -245,7 +245,11 @@ void API::processCommand(api_command_packet_t acp) {
             break ;
 
         case API_COMMAND_THROTTLE:
-            kb11hrottle = acp.arg0 ;
+            kb11speed = acp.arg0 < KB11_SPEED_COUNT ? acp.arg0 : KB11_SPEED_MAX ;
+            break;
+
+        case API_COMMAND_PASTE:
+            __atomic_store_n(&cpu.unibus.cons.pastereq, true, __ATOMIC_RELEASE) ; // the paste file task opens PASTE.TXT
             break;
         
         default:
@@ -266,7 +270,7 @@ void API::sendResponce(ApiCommand command, u32 arg0, u16 arg1) {
 
     arp.CSW = cpu.cpuStatus |
                 ((cpu.PSW >> 14) << 2) |
-                (kb11hrottle << 4) |
+                ((kb11speed != KB11_SPEED_MAX) << 4) |
                 (cpu.mmu.lastWasData << 5) |
                 (((cpu.mmu.SR[0] & 1) && ((cpu.mmu.SR[3] & 020) == 0) ? 1 : 0) << 6) |
                 (((cpu.mmu.SR[0] & 1) && (cpu.mmu.SR[3] & 020) ? 1 : 0) << 7)
@@ -17,7 +17,8 @@ enum ApiCommand : u8 {
     API_COMMAND_DEPOSIT,
     API_COMMAND_REBOOT,
     API_COMMAND_SHUTDOWN,
-    API_COMMAND_THROTTLE
+    API_COMMAND_THROTTLE,
+    API_COMMAND_PASTE
 } ;
 
 
@@ -8,15 +8,40 @@
 #include "logo.h"
 #include "firmware.h"
 #include "api.h"
+#include "paste.h"
+#include "telnet.h"
+#include "usbcons.h"
+#include <cons/vtscreen.h>
 #include "bootsel.h"
 
 #define DRIVE "SD:"
+
+// SYNC= applies to all drives, SYNC.RK0= to SYNC.RK7=, SYNC.RL0= to SYNC.RL3=, SYNC.TC0=, SYNC.RP0= to SYNC.RP7=
+// and SYNC.RA0= to SYNC.RA3= to one, COW.RK0= and on name the delta file a drive writes to
+#define SYNC_DRIVES (1 + 8 + 4 + TC11_UNITS + RH70_DRIVES + UDA50_UNITS)
+
+extern KB11 cpu ;
 extern volatile bool interrupted ;
+extern volatile u8 kb11speed ;
+extern volatile bool stopping ;
+extern volatile bool stopped ;
 
 typedef struct configuration {
     CString name;
     CString rk;
     CString rl;
+    CString speed;
+    CString flush;
+    CString latency;
+    CString contig;
+    CString baud;
+    CString telnet;
+    CString paste;
+    CString console;
+    CString vt;
+    CString sync[SYNC_DRIVES];  // SYNC= for every drive, then SYNC.RK0= on
+    CString cow[SYNC_DRIVES];   // delta files, [0] is unused
+    CString reset;
 } configuration_t ;
 
 static configuration_t configurations[5] = {
@@ -35,6 +60,45 @@ static const u8 netmask[]   = {255, 255, 255, 0} ;
 static const u8 gateway[]   = {172, 16, 103, 254} ;
 static const u8 dns[]       = {172, 16, 103, 254} ;
 
+static int sync_drive(const char *name) {
+    if (!*name) {
+        return 0 ;
+    }
+
+    if (strlen(name) != 4 || name[0] != '.' || name[3] < '0' || name[3] > '9') {
+        return -1 ;
+    }
+
+    const int u = name[3] - '0' ;
+    if (strncmp(name + 1, "RK", 2) == 0 && u < 8) {
+        return 1 + u ;
+    } else if (strncmp(name + 1, "RL", 2) == 0 && u < 4) {
+        return 9 + u ;
+    } else if (strncmp(name + 1, "TC", 2) == 0 && u < TC11_UNITS) {
+        return 13 + u ;
+    } else if (strncmp(name + 1, "RP", 2) == 0 && u < RH70_DRIVES) {
+        return 13 + TC11_UNITS + u ;
+    } else if (strncmp(name + 1, "RA", 2) == 0 && u < UDA50_UNITS) {
+        return 13 + TC11_UNITS + RH70_DRIVES + u ;
+    }
+
+    return -1 ;
+}
+
+static DiskImage *sync_image(const int d) {
+    if (d < 9) {
+        return &cpu.unibus.rk11.crtds[d - 1] ;
+    } else if (d < 13) {
+        return &cpu.unibus.rl11.disks[d - 9] ;
+    } else if (d < 13 + TC11_UNITS) {
+        return &cpu.unibus.tc11.units[d - 13].image ;
+    } else if (d < 13 + TC11_UNITS + RH70_DRIVES) {
+        return &cpu.unibus.rh70.drives[d - 13 - TC11_UNITS].image ;
+    }
+
+    return &cpu.unibus.uda50.units[d - 13 - TC11_UNITS - RH70_DRIVES].image ;
+}
+
 static int config_handler(void* user, const char* section, const char* name, const char* value) {
     int c = -1 ;
 
@@ -69,6 +133,40 @@ static int config_handler(void* user, const char* section, const char* name, con
             configurations[c].rk.Format("%s", value);
         } else if (strcmp(name, "RL") == 0) {
             configurations[c].rl.Format("%s", value);
+        } else if (strcmp(name, "SPEED") == 0) {
+            configurations[c].speed.Format("%s", value);
+        } else if (strcmp(name, "FLUSH") == 0) {
+            configurations[c].flush.Format("%s", value);
+        } else if (strcmp(name, "LATENCY") == 0) {
+            configurations[c].latency.Format("%s", value);
+        } else if (strcmp(name, "CONTIG") == 0) {
+            configurations[c].contig.Format("%s", value);
+        } else if (strcmp(name, "BAUD") == 0) {
+            configurations[c].baud.Format("%s", value);
+        } else if (strcmp(name, "TELNET") == 0) {
+            configurations[c].telnet.Format("%s", value);
+        } else if (strcmp(name, "PASTE") == 0) {
+            configurations[c].paste.Format("%s", value);
+        } else if (strcmp(name, "CONSOLE") == 0) {
+            configurations[c].console.Format("%s", value);
+        } else if (strcmp(name, "SCREEN") == 0) {
+            configurations[c].vt.Format("%s", value);
+        } else if (strncmp(name, "SYNC", 4) == 0) {
+            const int d = sync_drive(name + 4) ;
+            if (d < 0) {
+                gprintf("unknown drive %s", name) ;
+            } else {
+                configurations[c].sync[d].Format("%s", value);
+            }
+        } else if (strncmp(name, "COW", 3) == 0) {
+            const int d = sync_drive(name + 3) ;
+            if (d <= 0) {
+                gprintf("unknown drive %s", name) ;
+            } else {
+                configurations[c].cow[d].Format("%s", value);
+            }
+        } else if (strcmp(name, "RESET") == 0) {
+            configurations[c].reset.Format("%s", value);
         }
 
         return 1;
@@ -362,19 +460,87 @@ TShutdownMode CKernel::Run (void) {
 	const char *rk   = configurations[ci].rk ;
 	const char *rl   = configurations[ci].rl ;
 
+	if (configurations[ci].speed.Compare("REAL") == 0) {
+		kb11speed = KB11_SPEED_REAL ;
+	} else if (configurations[ci].speed.Compare("2X") == 0) {
+		kb11speed = KB11_SPEED_2X ;
+	}
+
+	if (configurations[ci].flush.GetLength() > 0) {
+		DiskImage::interval = atoi(configurations[ci].flush) ;
+	}
+
+	IOEngine::latency = configurations[ci].latency.Compare("ON") == 0 ;
+	DiskImage::contig = configurations[ci].contig.Compare("ON") == 0 ;
+
+	if (configurations[ci].baud.Compare("UNLIMITED") == 0) {
+		KL11::baud = 0 ;
+	} else if (configurations[ci].baud.GetLength() > 0) {
+		KL11::baud = atoi(configurations[ci].baud) > 0 ? atoi(configurations[ci].baud) : KL11_BAUD ;
+	}
+
+	Telnet::port = atoi(configurations[ci].telnet) ;
+	PasteServer::port = atoi(configurations[ci].paste) ;
+
+	if (configurations[ci].console.Compare("USB") == 0) {
+#if RASPPI == 4
+		USBConsole::enabled = true ;
+		KL11::serial = false ;
+#else
+		logger.Write("kernel", LogError, "CONSOLE=USB needs the USB-C port of a Pi 4") ;
+#endif
+	}
+
+	for (int d = 1; d < SYNC_DRIVES; d++) {
+		const char *policy = configurations[ci].sync[d].GetLength() > 0 ? configurations[ci].sync[d] : configurations[ci].sync[0] ;
+		if (*policy && !sync_image(d)->setsync(policy)) {
+			logger.Write("kernel", LogError, "unknown sync policy %s", policy) ;
+		}
+		if (configurations[ci].cow[d].GetLength() > 0) {
+			sync_image(d)->overlay(configurations[ci].cow[d], configurations[ci].reset.Compare("ON") == 0) ;
+		}
+	}
+
 	logger.Write("kernel", LogError, "Running %s", (const char *)configurations[ci].name) ;
 	this->console.sendString("\033[H\033[J") ;
 
+	// the screen terminal takes the display over, the log stays in the logger buffer
+	VTScreen *vt = 0 ;
+	if (configurations[ci].vt.Compare("VT100") == 0 || configurations[ci].vt.Compare("VT52") == 0) {
+		vt = new VTScreen(configurations[ci].vt.Compare("VT52") == 0) ;
+		CDevice *pTarget = deviceNameService.GetDevice(options.GetLogDevice(), FALSE) ;
+		if (pTarget == 0 || pTarget == &screen) {
+			logger.SetNewTarget(0) ;
+		}
+		if (!vt->Initialize()) {
+			delete vt ;
+			vt = 0 ;
+			logger.SetNewTarget(pTarget ? pTarget : &screen) ;
+		}
+	}
+
 	multiCore.Initialize((char *)rk, (char *)rl, ci > 0) ;
 
-	timer.StartKernelTimer(500, [](TKernelTimerHandle hTimer, void *pParam, void *pContext) {
-		CScreenDevice *scr = (CScreenDevice *)pContext ;
-	    scr->GetFrameBuffer()->SetBacklightBrightness(0) ;
-	}, 0, &screen) ;
+	if (!vt) {
+		timer.StartKernelTimer(500, [](TKernelTimerHandle hTimer, void *pParam, void *pContext) {
+			CScreenDevice *scr = (CScreenDevice *)pContext ;
+		    scr->GetFrameBuffer()->SetBacklightBrightness(0) ;
+		}, 0, &screen) ;
+	}
 
 	multiCore.Run(0) ;
 
-	f_unmount(DRIVE) ;
+	// let the emulator core write back its disk images before the card goes away,
+	// once it has begun that takes as long as it takes
+	for (unsigned t = 0; !stopped && (stopping || t < 5000); t++) {
+		CTimer::SimpleMsDelay(1) ;
+	}
+
+	if (stopped) {
+		f_unmount(DRIVE) ;
+	} else {
+		logger.Write("kernel", LogError, "the emulator core did not stop, disk images not written back") ;
+	}
 	
     screen.GetFrameBuffer()->SetBacklightBrightness(100) ;
 	logger.Write("kernel", LogError, "SHUTDOWN") ;
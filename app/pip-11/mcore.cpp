@@ -1,13 +1,31 @@
 #include "mcore.h"
 
 #include <circle/logger.h>
+#include <circle/synchronize.h>
 #include <cons/cons.h>
+#include <cons/vtscreen.h>
 #include <util/queue.h>
 #include "api.h"
+#include "paste.h"
+#include "telnet.h"
+#include "usbcons.h"
+
+extern KB11 cpu ;
 
 volatile bool interrupted = false ;
 volatile bool halted = false ;
-volatile bool kb11hrottle = false ;
+volatile u8 kb11speed = KB11_SPEED_MAX ;
+
+static const char *speedname(const u8 speed) {
+    switch (speed) {
+        case KB11_SPEED_REAL:
+            return "REAL" ;
+        case KB11_SPEED_2X:
+            return "2X" ;
+        default:
+            return "MAX" ;
+    }
+}
 
 MultiCore::MultiCore(CMemorySystem *pMemorySystem, Console *pConsole, CCPUThrottle *pCpuThrottle)
 :   CMultiCoreSupport (pMemorySystem),
@@ -32,6 +50,7 @@ boolean MultiCore::Initialize(char *kf, char *lf, bool bm) {
 }
 
 TShutdownMode startup(const char *rkfile, const char *rlfile, const bool bootmon) ;
+void iocore() ;
 // void hw_step() ;
 
 void MultiCore::Run(unsigned ncore) {
@@ -40,6 +59,16 @@ void MultiCore::Run(unsigned ncore) {
     if (ncore == 0) {
         CNetSubSystem *net = CNetSubSystem::Get() ;
         api = new API(net) ;
+        if (Telnet::port) {
+            new Telnet(net, &cpu.unibus.dz11) ;
+        }
+        if (PasteServer::port) {
+            new PasteServer(net, &cpu.unibus.cons) ;
+        }
+        new PasteFile(&cpu.unibus.cons) ;
+        if (USBConsole::enabled) {
+            new USBConsole(&cpu.unibus.cons) ;
+        }
 
         while (!interrupted) {
             TShutdownMode mode = api->loop() ;
@@ -68,15 +97,16 @@ void MultiCore::Run(unsigned ncore) {
                 return ;
             }
 
+            if (VTScreen *vt = VTScreen::get()) {
+                vt->update() ;
+            }
+
             cpuThrottle->Update() ;
         }
     }
 
     if (ncore == 3) {
-        return ;
-        // while (!interrupted) {
-        //     hw_step() ;
-        // }
+        iocore() ;
     }
 }
 
@@ -91,9 +121,11 @@ void MultiCore::IPIHandler(unsigned ncore, unsigned nipi) {
     }
 
     if (nipi == IPI_USER + 2) {
-        kb11hrottle = !kb11hrottle ;
-        CLogger::Get()->Write("MultiCore", LogError, "KB11 Throttle %s", kb11hrottle ? "LOW" : "HIGH") ;
+        kb11speed = (kb11speed + 1) % KB11_SPEED_COUNT ;
+        CLogger::Get()->Write("MultiCore", LogError, "KB11 Speed %s", speedname(kb11speed)) ;
     }
 
+    SendEvent() ; // wake the emulator core if it naps in WAIT
+
     CMultiCoreSupport::IPIHandler(ncore, nipi) ;
 }
@@ -0,0 +1,107 @@
+#include "paste.h"
+
+#include <circle/logger.h>
+#include <circle/net/in.h>
+#include <circle/net/ipaddress.h>
+#include <circle/sched/scheduler.h>
+
+u16 PasteServer::port = 0 ;
+
+PasteServer::PasteServer(CNetSubSystem *pNet, KL11 *pKL)
+:   pnet(pNet),
+    kl(pKL),
+    listenSocket(0)
+{
+}
+
+PasteServer::~PasteServer(void) {
+    delete listenSocket ;
+    listenSocket = 0 ;
+    pnet = 0 ;
+}
+
+void PasteServer::Run(void) {
+    listenSocket = new CSocket(pnet, IPPROTO_TCP) ;
+    if (listenSocket->Bind(port) < 0 || listenSocket->Listen(1) < 0) {
+        CLogger::Get()->Write("paste", LogError, "Cannot listen on port %u", port) ;
+        return ;
+    }
+
+    while (true) {
+        CIPAddress ip ;
+        u16 rport ;
+        CSocket *s = listenSocket->Accept(&ip, &rport) ;
+        if (!s) {
+            continue ;
+        }
+
+        serve(s) ;
+        delete s ;
+    }
+}
+
+void PasteServer::serve(CSocket *s) {
+    u8 buf[FRAME_BUFFER_SIZE] ;
+    u32 total = 0 ;
+
+    while (true) {
+        if (kl->netin.room() < FRAME_BUFFER_SIZE) {
+            CScheduler::Get()->MsSleep(PASTE_POLL) ;
+            continue ;
+        }
+
+        const int n = s->Receive(buf, sizeof buf, 0) ;
+        if (n <= 0) {
+            break ;
+        }
+
+        for (int i = 0; i < n; i++) {
+            kl->netin.put(buf[i]) ;
+        }
+        total += n ;
+    }
+
+    CLogger::Get()->Write("paste", LogNotice, "%u bytes pasted", total) ;
+}
+
+PasteFile::PasteFile(KL11 *pKL)
+:   kl(pKL)
+{
+}
+
+void PasteFile::Run(void) {
+    FIL file ;
+    bool open = false ;
+    u8 buf[PASTE_READ] ;
+    UINT n = 0, i = 0 ; // bytes in buf, and given to the ring
+
+    while (true) {
+        if (__atomic_load_n(&kl->pastereq, __ATOMIC_ACQUIRE)) {
+            __atomic_store_n(&kl->pastereq, false, __ATOMIC_RELAXED) ;
+            if (open) {
+                f_close(&file) ;
+            }
+            FRESULT fr = f_open(&file, KL11_PASTE, FA_READ) ;
+            open = FR_OK == fr ;
+            n = i = 0 ;
+            if (!open) {
+                CLogger::Get()->Write("paste", LogError, "%s: open error %d", KL11_PASTE, fr) ;
+            }
+        }
+
+        if (open && i == n) {
+            i = 0 ;
+            if (FR_OK != f_read(&file, buf, sizeof buf, &n) || n == 0) {
+                f_close(&file) ;
+                open = false ;
+                n = 0 ;
+            }
+        }
+
+        while (i < n && kl->filein.put(buf[i])) {
+            i++ ;
+        }
+
+        CScheduler::Get()->MsSleep(PASTE_POLL) ;
+    }
+}
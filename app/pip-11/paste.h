@@ -0,0 +1,46 @@
+#pragma once
+
+#include <circle/types.h>
+#include <circle/sched/task.h>
+#include <circle/net/netsubsystem.h>
+#include <circle/net/socket.h>
+#include <arm11/kl11.h>
+
+#define PASTE_POLL 5 // ms between looks at the console ring when it is full
+#define PASTE_READ 512 // bytes of PASTE.TXT read at a time
+
+/*
+ * Paste server. Whatever a client sends goes to the console input, one
+ * connection at a time, e.g. nc pip11 port < prog.mac. The socket is only
+ * read while the console ring has room, so the guest sets the pace.
+ */
+class PasteServer : public CTask {
+    public:
+        PasteServer(CNetSubSystem *pNet, KL11 *pKL) ;
+        ~PasteServer(void) ;
+        void Run(void) ;
+
+        static u16 port ; // PASTE= in CONFIG.INI, 0 leaves the server off
+
+    private:
+        void serve(CSocket *s) ;
+
+        CNetSubSystem *pnet ;
+        KL11 *kl ;
+        CSocket *listenSocket ;
+} ;
+
+/*
+ * Paste file reader. When the console asks for it, PASTE.TXT is read from the
+ * card onto the file ring of the console, as far as the ring has room. The
+ * card is read here on core 0, where waiting for a long transfer of the I/O
+ * core does not hold the emulator up.
+ */
+class PasteFile : public CTask {
+    public:
+        PasteFile(KL11 *pKL) ;
+        void Run(void) ;
+
+    private:
+        KL11 *kl ;
+} ;
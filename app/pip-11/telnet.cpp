@@ -0,0 +1,190 @@
+#include "telnet.h"
+
+#include <circle/logger.h>
+#include <circle/net/in.h>
+#include <circle/net/ipaddress.h>
+#include <circle/sched/scheduler.h>
+#include <circle/string.h>
+
+// telnet commands and options
+#define TN_SE   240
+#define TN_SB   250
+#define TN_WILL 251
+#define TN_DO   253
+#define TN_DONT 254
+#define TN_IAC  255
+#define TO_ECHO 1
+#define TO_SGA  3
+
+enum TelnetState : u8 {
+    TS_DATA,
+    TS_IAC,     // after IAC
+    TS_OPTION,  // after WILL, WONT, DO or DONT
+    TS_SB,      // in a subnegotiation
+    TS_SBIAC    // IAC in a subnegotiation
+} ;
+
+u16 Telnet::port = 0 ;
+
+Telnet::Telnet(CNetSubSystem *pNet, DZ11 *pDZ)
+:   pnet(pNet),
+    dz(pDZ),
+    listenSocket(0)
+{
+}
+
+Telnet::~Telnet(void) {
+    delete listenSocket ;
+    listenSocket = 0 ;
+    pnet = 0 ;
+}
+
+void Telnet::Run(void) {
+    listenSocket = new CSocket(pnet, IPPROTO_TCP) ;
+    if (listenSocket->Bind(port) < 0 || listenSocket->Listen() < 0) {
+        CLogger::Get()->Write("telnet", LogError, "Cannot listen on port %u", port) ;
+        return ;
+    }
+
+    while (true) {
+        CIPAddress ip ;
+        u16 rport ;
+        CSocket *s = listenSocket->Accept(&ip, &rport) ;
+        if (!s) {
+            continue ;
+        }
+
+        int l = dz->connect() ;
+        if (l < 0) {
+            static const char busy[] = "\r\nAll lines are busy\r\n" ;
+            s->Send(busy, sizeof busy - 1, 0) ;
+            delete s ;
+            continue ;
+        }
+
+        CString from ;
+        ip.Format(&from) ;
+        CLogger::Get()->Write("telnet", LogNotice, "%s:%u on line %d", (const char *) from, rport, l) ;
+        new TelnetLine(s, dz, l) ;
+    }
+}
+
+TelnetLine::TelnetLine(CSocket *pSocket, DZ11 *pDZ, const u8 nLine)
+:   socket(pSocket),
+    dz(pDZ),
+    line(nLine),
+    iac(TS_DATA),
+    cr(false)
+{
+}
+
+TelnetLine::~TelnetLine(void) {
+    delete socket ;
+    socket = 0 ;
+}
+
+void TelnetLine::Run(void) {
+    // the server echoes and sends characters as they come
+    static const u8 hello[] = {TN_IAC, TN_WILL, TO_ECHO, TN_IAC, TN_WILL, TO_SGA, TN_IAC, TN_DO, TO_SGA} ;
+    socket->Send(hello, sizeof hello, 0) ;
+
+    // what the guest sent while the line was free is not for this user
+    DZLine &l = dz->lines[line] ;
+    const u8 *p ;
+    u32 n ;
+    while ((n = l.tx.peek(p)) > 0) {
+        l.tx.drop(n) ;
+    }
+
+    while (true) {
+        const int r = receive() ;
+        const int s = send() ;
+        if (r < 0 || s < 0) {
+            break ;
+        }
+
+        if (r || s) {
+            CScheduler::Get()->Yield() ;
+        } else {
+            CScheduler::Get()->MsSleep(TELNET_POLL) ;
+        }
+    }
+
+    dz->hangup(line) ;
+    CLogger::Get()->Write("telnet", LogNotice, "line %u hung up", line) ;
+}
+
+// receive strips the telnet commands, CR LF and CR NUL come in as CR
+int TelnetLine::receive(void) {
+    DZLine &l = dz->lines[line] ;
+    if (l.rx.room() < FRAME_BUFFER_SIZE) {
+        return 0 ; // the guest is behind, let the window close
+    }
+
+    u8 buf[FRAME_BUFFER_SIZE] ;
+    const int n = socket->Receive(buf, sizeof buf, MSG_DONTWAIT) ;
+    for (int i = 0; i < n; i++) {
+        const u8 c = buf[i] ;
+        switch (iac) {
+            case TS_DATA:
+                if (c == TN_IAC) {
+                    iac = TS_IAC ;
+                } else if (cr && (c == '\n' || c == 0)) {
+                    cr = false ;
+                } else {
+                    cr = c == '\r' ;
+                    l.rx.put(c) ;
+                }
+                break ;
+            case TS_IAC:
+                if (c == TN_IAC) {
+                    l.rx.put(c) ;
+                    iac = TS_DATA ;
+                } else if (c >= TN_WILL && c <= TN_DONT) {
+                    iac = TS_OPTION ;
+                } else {
+                    iac = c == TN_SB ? TS_SB : TS_DATA ;
+                }
+                break ;
+            case TS_OPTION:
+                iac = TS_DATA ;
+                break ;
+            case TS_SB:
+                if (c == TN_IAC) {
+                    iac = TS_SBIAC ;
+                }
+                break ;
+            case TS_SBIAC:
+                iac = c == TN_SE ? TS_DATA : TS_SB ;
+                break ;
+        }
+    }
+
+    return n ;
+}
+
+// send gathers what the guest wrote into one segment, IAC doubled
+int TelnetLine::send(void) {
+    DZLine &l = dz->lines[line] ;
+    u8 buf[TELNET_SEGMENT] ;
+    u32 n = 0 ;
+
+    const u8 *p ;
+    u32 k ;
+    while (n < TELNET_SEGMENT - 1 && (k = l.tx.peek(p)) > 0) {
+        u32 i = 0 ;
+        for (; i < k && n < TELNET_SEGMENT - 1; i++) {
+            if (p[i] == TN_IAC) {
+                buf[n++] = TN_IAC ;
+            }
+            buf[n++] = p[i] ;
+        }
+        l.tx.drop(i) ;
+    }
+
+    if (!n) {
+        return 0 ;
+    }
+
+    return socket->Send(buf, n, 0) ;
+}
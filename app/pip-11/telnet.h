@@ -0,0 +1,47 @@
+#pragma once
+
+#include <circle/types.h>
+#include <circle/sched/task.h>
+#include <circle/net/netsubsystem.h>
+#include <circle/net/socket.h>
+#include <arm11/dz11.h>
+
+#define TELNET_SEGMENT 1024 // most bytes put in one TCP segment
+#define TELNET_POLL 5       // ms a line sleeps when nothing moved
+
+/*
+ * Telnet server for the DZ11 lines. Every connection gets the next free
+ * line and a task of its own on core 0, which moves the line rings to and
+ * from the socket. What the guest sends is gathered and goes out a segment
+ * at a time. A full receive ring leaves the data in the TCP window.
+ */
+class Telnet : public CTask {
+    public:
+        Telnet(CNetSubSystem *pNet, DZ11 *pDZ) ;
+        ~Telnet(void) ;
+        void Run(void) ;
+
+        static u16 port ; // TELNET= in CONFIG.INI, 0 leaves the server off
+
+    private:
+        CNetSubSystem *pnet ;
+        DZ11 *dz ;
+        CSocket *listenSocket ;
+} ;
+
+class TelnetLine : public CTask {
+    public:
+        TelnetLine(CSocket *pSocket, DZ11 *pDZ, const u8 nLine) ;
+        ~TelnetLine(void) ;
+        void Run(void) ;
+
+    private:
+        int receive(void) ;
+        int send(void) ;
+
+        CSocket *socket ;
+        DZ11 *dz ;
+        u8 line ;
+        u8 iac ; // where in a command sequence the input is
+        bool cr ;
+} ;
@@ -0,0 +1,85 @@
+#include "usbcons.h"
+
+#include <circle/devicenameservice.h>
+#include <circle/interrupt.h>
+#include <circle/logger.h>
+#include <circle/sched/scheduler.h>
+
+bool USBConsole::enabled = false ;
+
+USBConsole::USBConsole(KL11 *pKL)
+:   kl(pKL),
+    gadget(0)
+{
+}
+
+USBConsole::~USBConsole(void) {
+    delete gadget ;
+    gadget = 0 ;
+}
+
+void USBConsole::Run(void) {
+    gadget = new CUSBCDCGadget(CInterruptSystem::Get()) ;
+    if (!gadget->Initialize()) {
+        CLogger::Get()->Write("usbcons", LogError, "Cannot initialize the USB gadget") ;
+        return ;
+    }
+
+    while (true) {
+        // the device comes and goes with the host, it is looked up every time
+        gadget->UpdatePlugAndPlay() ;
+        CDevice *dev = CDeviceNameService::Get()->GetDevice(USBCONS_DEVICE, FALSE) ;
+
+        int r = 0, s = 0 ;
+        if (dev) {
+            r = receive(dev) ;
+            s = send(dev) ;
+        } else {
+            const u8 *p ;
+            u32 n ;
+            while ((n = kl->hostpeek(p)) > 0) {
+                kl->hostdrop(n) ;
+            }
+        }
+
+        if (r > 0 || s > 0) {
+            CScheduler::Get()->Yield() ;
+        } else {
+            CScheduler::Get()->MsSleep(USBCONS_POLL) ;
+        }
+    }
+}
+
+// receive reads no more than the receive ring takes, the rest waits in the endpoint
+int USBConsole::receive(CDevice *dev) {
+    u8 buf[USBCONS_BULK] ;
+    const u32 room = kl->hostroom() ;
+    if (!room) {
+        return 0 ;
+    }
+
+    const int n = dev->Read(buf, room < sizeof buf ? room : sizeof buf) ;
+    for (int i = 0; i < n; i++) {
+        kl->hostput(buf[i]) ;
+    }
+
+    return n ;
+}
+
+// send hands the transmit ring to the bulk endpoint as far as its queue takes
+int USBConsole::send(CDevice *dev) {
+    int total = 0 ;
+
+    const u8 *p ;
+    u32 n ;
+    while ((n = kl->hostpeek(p)) > 0) {
+        const int w = dev->Write(p, n < USBCONS_BULK ? n : USBCONS_BULK) ;
+        if (w <= 0) {
+            break ;
+        }
+        kl->hostdrop(w) ;
+        total += w ;
+    }
+
+    return total ;
+}
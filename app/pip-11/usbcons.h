@@ -0,0 +1,34 @@
+#pragma once
+
+#include <circle/types.h>
+#include <circle/device.h>
+#include <circle/sched/task.h>
+#include <circle/usb/gadget/usbcdcgadget.h>
+#include <arm11/kl11.h>
+
+#define USBCONS_DEVICE "utty1" // the CDC ACM interface once the host has configured it
+#define USBCONS_POLL 1         // ms the task sleeps when nothing moved
+#define USBCONS_BULK 512       // bytes handed to the bulk IN endpoint at a time, a high-speed packet
+
+/*
+ * Console terminal on the USB-C port of the Pi 4, seen by the host as a
+ * CDC ACM device (/dev/ttyACM0). The task on core 0 owns the gadget: it
+ * keeps up with plug and play and moves the KL11 rings to and from the bulk
+ * endpoints, so the console is not held to the UART rate. Nothing plugged
+ * in, what the guest writes is lost like on a terminal that is switched off.
+ */
+class USBConsole : public CTask {
+    public:
+        USBConsole(KL11 *pKL) ;
+        ~USBConsole(void) ;
+        void Run(void) ;
+
+        static bool enabled ; // CONSOLE=USB in CONFIG.INI
+
+    private:
+        int receive(CDevice *dev) ;
+        int send(CDevice *dev) ;
+
+        KL11 *kl ;
+        CUSBCDCGadget *gadget ;
+} ;